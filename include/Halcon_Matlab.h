@@ -9,6 +9,8 @@
 #  endif
 #endif
 #define Test_EXPORTS_API __declspec(dllexport)
+#define H_ERR_MATLAB_ENGINE 9999 // MATLAB 引擎调用失败或变量不存在
+#define H_ERR_MATLAB_OPEN 9998 // 引擎已经打开，Matlab_engOpenParam 的启动参数不会生效
 
 
 
@@ -27,6 +29,24 @@ extern "C" {
 	extern Test_EXPORTS_API Herror HMatlab_engSetVisible(Hproc_handle proc_handle);
 	extern Test_EXPORTS_API Herror HMatlab_engSetmxArray(Hproc_handle proc_handle);
 	extern Test_EXPORTS_API Herror HMatlab_engGetmxArray(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engFeval(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engSetParam(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetParam(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engFlush(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engPutRegion(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetRegion(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engPutXLD(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetXLD(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engSetSparse(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetSparse(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engPutImage(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetImage(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engSetComplexArray(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engGetComplexArray(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engUpdateSubarray(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engUpdateImage(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engWorkspaceInfo(Hproc_handle proc_handle);
+	extern Test_EXPORTS_API Herror HMatlab_engOpenParam(Hproc_handle proc_handle);
 
 #pragma endregion
 
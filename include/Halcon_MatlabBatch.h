@@ -0,0 +1,62 @@
+#pragma once
+// Matlab_engFeval 的小调用合并：多个线程在一个时间窗口内对同一函数 (同一会话、相同的参数
+// 和结果个数) 的调用攒成一批，由第一个到达的线程 (leader) 一次提交给引擎，结果再分发回
+// 各个调用方。窗口到时或攒够 max_calls 个时提交。
+#include "Halcon_MatlabCache.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 批里的一次调用，leader 执行时填写 outputs 和 result；result 由调用方预先设为失败时的错误码
+struct HMatlabBatchCall
+{
+	const std::vector<HMatlabMatrix> *inputs;
+	std::vector<HMatlabMatrix> *outputs;
+	int result;
+	bool done;
+};
+
+class HMatlabFevalBatcher
+{
+public:
+	typedef std::function<void(std::vector<HMatlabBatchCall *> &calls)> Runner;
+
+	HMatlabFevalBatcher();
+
+	// 窗口为 0 时不合并，Submit 直接在调用线程执行 run
+	uint64_t WindowUs();
+	void SetWindowUs(uint64_t window_us);
+	size_t MaxCalls();
+	void SetMaxCalls(size_t max_calls);
+
+	// key 相同的调用合并。call 所在的批由 leader 调用 run 执行，返回时 call 已完成
+	void Submit(const std::string &key, HMatlabBatchCall *call, const Runner &run);
+
+	// 统计：提交的批数 (不含只有一个调用的批)、这些批里的调用数、最大批大小
+	uint64_t Batches();
+	uint64_t BatchedCalls();
+	uint64_t LargestBatch();
+	void ResetStats();
+
+private:
+	struct Batch
+	{
+		std::vector<HMatlabBatchCall *> calls;
+		std::condition_variable full;
+	};
+
+	std::mutex mutex_;
+	std::condition_variable done_;
+	std::map<std::string, Batch *> open_;
+	uint64_t window_us_;
+	size_t max_calls_;
+	uint64_t batches_;
+	uint64_t batched_calls_;
+	uint64_t largest_;
+};
+
+HMatlabFevalBatcher &HMatlabGetFevalBatcher();
@@ -0,0 +1,77 @@
+#pragma once
+// Matlab_engFeval 的结果缓存：按 (函数名, 输出个数, 输入内容哈希) 做 LRU，
+// 可选的磁盘层用 MAT 文件持久化，进程重启后依然命中。
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// HALCON 矩阵和 MATLAB double 矩阵之间的中间形式，数据按列优先存放
+struct HMatlabMatrix
+{
+	size_t rows;
+	size_t cols;
+	std::vector<double> data;
+};
+
+// 按 8 字节分组混合的 64 位哈希，供缓存键等场景使用
+uint64_t HMatlabHashBytes(const void *data, size_t size, uint64_t seed);
+
+class HMatlabResultCache
+{
+public:
+	HMatlabResultCache();
+
+	// 缓存键：函数名、nargout 和每个输入的尺寸与内容
+	std::string MakeKey(const char *func, size_t nargout,
+						const std::vector<HMatlabMatrix> &inputs) const;
+	bool Lookup(const std::string &key, std::vector<HMatlabMatrix> *outputs);
+	void Insert(const std::string &key, const std::vector<HMatlabMatrix> &outputs);
+	void Clear();
+
+	bool Enabled();
+	void SetEnabled(bool enabled);
+	size_t MaxBytes();
+	void SetMaxBytes(size_t max_bytes);
+	std::string Dir();
+	void SetDir(const std::string &dir);
+
+	uint64_t Hits();
+	uint64_t Misses();
+	uint64_t DiskHits();
+	size_t Bytes();
+	size_t Entries();
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::vector<HMatlabMatrix> outputs;
+		size_t bytes;
+	};
+
+	void InsertLocked(const std::string &key, const std::vector<HMatlabMatrix> &outputs);
+	void EvictLocked();
+	static std::string DiskPath(const std::string &dir, const std::string &key);
+	static bool DiskLoad(const std::string &dir, const std::string &key,
+						 std::vector<HMatlabMatrix> *outputs);
+	static void DiskStore(const std::string &dir, const std::string &key,
+						  const std::vector<HMatlabMatrix> &outputs);
+
+	std::mutex mutex_;
+	std::list<Entry> lru_; // 头部为最近使用
+	std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+	bool enabled_;
+	size_t max_bytes_;
+	size_t bytes_;
+	std::string dir_;
+	uint64_t hits_;
+	uint64_t misses_;
+	uint64_t disk_hits_;
+};
+
+// 进程内唯一的结果缓存
+HMatlabResultCache &HMatlabGetResultCache();
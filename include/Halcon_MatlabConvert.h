@@ -0,0 +1,54 @@
+#pragma once
+// HALCON 字典/元组/图标对象和 MATLAB 数组之间的递归转换。
+// HALCON -> MATLAB：
+//   字典          -> 1x1 结构体 (逐层递归)
+//   矩阵句柄      -> double 矩阵
+//   数值元组      -> 1xn double 行向量；put_integer_class 为 'int64' 时全是整数的元组为 int64
+//   字符串元组    -> 单个为 char，多个为 1xn 元胞 (cellstr)
+//   混合元组      -> 1xn 元胞
+//   图像 / 区域   -> 见 Matlab_engPutImage；区域为外接范围大小的 logical 图像
+// MATLAB -> HALCON 反过来；结构体数组得到字典句柄元组，两行及以上的非 double 数值数组得到图像，
+// logical 数组得到区域，标量和行向量都是元组。不支持的类型 (函数句柄、稀疏阵等) 出现在任何
+// 一层都报错。MATLAB 的 string 数组事先在 MATLAB 里转成 char (见调用处)。
+// MATLAB 的 C 接口不能创建 string 数组，字符串元组上传成 cellstr，需要时用 string(x) 转换。
+#include "Halcon_Matlab.h"
+#include "Halcon_MatlabSession.h"
+
+#ifndef __APPLE__
+#include "HalconCpp.h"
+#else
+#ifndef HC_LARGE_IMAGES
+#include <HALCONCpp/HalconCpp.h>
+#else
+#include <HALCONCppxl/HalconCpp.h>
+#endif
+#endif
+
+// 字典里的一个值：元组或图标对象
+struct HMatlabDictEntry
+{
+	bool is_object;
+	HalconCpp::HTuple tuple;
+	HalconCpp::HObject object;
+};
+
+// HALCON -> MATLAB。返回的数组可能含有池里的子数组，用 HMatlabReleaseMx 释放。
+// HALCON 算子抛出的 HException 不在这里捕获。
+Herror HMatlabDictValueToMx(Hproc_handle proc_handle, HMatlabSession &session,
+							const HalconCpp::HTuple &dict, const HalconCpp::HTuple &key, mxArray **out);
+Herror HMatlabTupleToMx(Hproc_handle proc_handle, HMatlabSession &session,
+						const HalconCpp::HTuple &value, mxArray **out);
+// 逐层摘下结构体、元胞里的子数组归还给池，再销毁容器本身
+void HMatlabReleaseMx(HMatlabSession &session, mxArray *A);
+
+// MATLAB -> HALCON。matrix_always 为 true 时 double 数组一律转成矩阵句柄
+// (Matlab_engGetVariable 顶层的旧行为)，否则标量和行向量转成普通元组。
+Herror HMatlabMxToDictEntry(const mxArray *A, bool matrix_always, HMatlabDictEntry *entry);
+void HMatlabSetDictEntry(const HalconCpp::HTuple &dict, const HalconCpp::HTuple &key,
+						 const HMatlabDictEntry &entry);
+
+// 图标对象和 MATLAB 数组，在 Halcon_MatlabImage.cpp / Halcon_MatlabRegion.cpp 中实现
+Herror HMatlabImageToMx(Hproc_handle proc_handle, HMatlabSession &session, Hkey key, mxArray **out);
+Herror HMatlabMxToImageObject(const mxArray *A, HalconCpp::HObject *image);
+Herror HMatlabRegionToMx(Hproc_handle proc_handle, Hkey key, mxArray **out);
+Herror HMatlabMxToRegionObject(const mxArray *A, HalconCpp::HObject *region);
@@ -0,0 +1,22 @@
+#pragma once
+// CPU 划分：查询核数、解析核列表、把引擎进程绑到指定的核上；以及引擎进程的内存占用。
+// MATLAB 自带的 libmwgetnumcores 依赖 Simulink Coder 的 rtwtypes.h (不在 3rd 里)，
+// 而且运行时还要找 MATLAB 的 bin 目录，这里直接问操作系统。
+// 核掩码用 64 位整数，Windows 上只覆盖进程所在的处理器组。
+#include <cstdint>
+#include <string>
+
+size_t HMatlabLogicalCores();
+// 查不到时等于逻辑核数
+size_t HMatlabPhysicalCores();
+
+// "0-3,6" 形式的核列表和掩码互转，核序号从 0 开始，不超过 63
+bool HMatlabParseCoreSet(const std::string &spec, uint64_t *mask);
+std::string HMatlabFormatCoreSet(uint64_t mask);
+size_t HMatlabCoreCount(uint64_t mask);
+
+// 把进程 pid 的所有线程限制在 mask 上
+bool HMatlabSetProcessCores(int64_t pid, uint64_t mask);
+
+// 进程的常驻内存和峰值 (字节)，取不到时为 0
+bool HMatlabProcessMemory(int64_t pid, uint64_t *resident, uint64_t *peak);
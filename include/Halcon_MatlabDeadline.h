@@ -0,0 +1,43 @@
+#pragma once
+// Matlab_engFeval 的截止时间：时钟、按函数统计的超时次数和超时时使用的上次结果。
+// 截止时间是 HMatlabClockUs 的绝对值，调用方用 Matlab_engGetParam('clock_us') 取当前时间。
+#include "Halcon_MatlabCache.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 单调时钟，微秒
+uint64_t HMatlabClockUs();
+
+class HMatlabDeadlineLog
+{
+public:
+	// 记一次超时：rejected 为 true 表示截止时间前没能开始执行，否则是执行超时
+	void RecordMiss(const std::string &func, bool rejected);
+	// func 为空时返回所有函数的合计
+	uint64_t Misses(const std::string &func);
+	uint64_t Rejected(const std::string &func);
+
+	// 函数 (按输出个数区分) 最近一次按时完成的结果
+	void SetLast(const std::string &func, size_t nargout, const std::vector<HMatlabMatrix> &outputs);
+	bool GetLast(const std::string &func, size_t nargout, std::vector<HMatlabMatrix> *outputs);
+
+	// 只清空计数，上次结果保留
+	void Reset();
+
+private:
+	struct Counts
+	{
+		Counts() : misses(0), rejected(0) {}
+		uint64_t misses;
+		uint64_t rejected;
+	};
+
+	std::mutex mutex_;
+	std::map<std::string, Counts> counts_;
+	std::map<std::string, std::vector<HMatlabMatrix> > last_;
+};
+
+HMatlabDeadlineLog &HMatlabGetDeadlineLog();
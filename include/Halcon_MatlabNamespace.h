@@ -0,0 +1,41 @@
+#pragma once
+// 工作区命名空间：多个线程共用一个引擎时各自的变量互不覆盖。
+// 线程设置了命名空间后，它的用户变量放在基本工作区的结构体 hm_ns_<id>__ 里：
+// put / get 读写结构体的字段，eval 的语句交给生成的函数 hm_ns_exec__ 在函数作用域里执行
+// (字段先取成局部变量，执行完再写回结构体)。内部临时变量 hm_*__ 仍在基本工作区，
+// 语句里照样能用。每条语句独占引擎，但不同命名空间的工作流之间不需要更大的锁。
+// 语句里不能用不带参数的 clear / clear all，它会清掉 hm_ns_exec__ 自己的参数。
+#include <string>
+
+// id 只能含字母、数字和下划线；空串表示不用命名空间，直接读写基本工作区
+bool HMatlabIsNamespaceId(const std::string &id);
+const std::string &HMatlabThreadNamespace();
+void HMatlabSetThreadNamespace(const std::string &id);
+
+// 在作用域内替别的线程使用它的命名空间 (调度线程、带截止时间的后台线程)
+class HMatlabNamespaceGuard
+{
+public:
+	explicit HMatlabNamespaceGuard(const std::string &id) : saved_(HMatlabThreadNamespace())
+	{
+		HMatlabSetThreadNamespace(id);
+	}
+	~HMatlabNamespaceGuard() { HMatlabSetThreadNamespace(saved_); }
+
+private:
+	HMatlabNamespaceGuard(const HMatlabNamespaceGuard &);
+	HMatlabNamespaceGuard &operator=(const HMatlabNamespaceGuard &);
+
+	std::string saved_;
+};
+
+// 命名空间在基本工作区里的结构体名 hm_ns_<id>__
+std::string HMatlabNamespaceVar(const std::string &id);
+// 调用线程的用户变量在基本工作区里的写法：有命名空间时为 hm_ns_<id>__.expr，否则就是 expr。
+// 扩展自己生成的下标赋值 / 读取 (NAME(r,c)=hm_sub__ 之类) 用它直接访问字段，并在基本工作区
+// 执行 (HMatlabNamespaceGuard 置空)：经过 hm_ns_exec__ 时字段先取成局部变量，下标赋值会
+// 复制整个数组，结构体也要整个重建
+std::string HMatlabNamespaceRef(const std::string &expr);
+// 把 cmd 改写成在命名空间 id 里执行的 hm_ns_exec__ 调用。path_added 为假时先把生成
+// 函数所在的目录加入引擎的路径并置为真；生成函数写不出来时返回空串
+std::string HMatlabNamespaceWrap(const std::string &id, const std::string &cmd, bool *path_added);
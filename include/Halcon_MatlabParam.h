@@ -0,0 +1,49 @@
+#pragma once
+// 通用参数 (GenParamName/GenParamValue) 的解析，各算子共用
+#include "Halcon_Matlab.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+inline std::string HMatlabParString(const Hcpar &par)
+{
+	char buf[64];
+	switch (par.type)
+	{
+	case STRING_PAR:
+		return par.par.s;
+	case LONG_PAR:
+		snprintf(buf, sizeof(buf), "%lld", (long long)par.par.l);
+		return buf;
+	case DOUBLE_PAR:
+		snprintf(buf, sizeof(buf), "%.17g", par.par.d);
+		return buf;
+	default:
+		return "";
+	}
+}
+
+inline double HMatlabParDouble(const Hcpar &par)
+{
+	switch (par.type)
+	{
+	case LONG_PAR:
+		return (double)par.par.l;
+	case DOUBLE_PAR:
+		return par.par.d;
+	case STRING_PAR:
+		return atof(par.par.s);
+	default:
+		return 0.0;
+	}
+}
+
+inline bool HMatlabParBool(const Hcpar &par)
+{
+	if (par.type == STRING_PAR)
+	{
+		return strcmp(par.par.s, "true") == 0 || strcmp(par.par.s, "1") == 0;
+	}
+	return HMatlabParDouble(par) != 0.0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+// 会话内复用的 mxArray 池，按 (类型, 实/复数) 分组、按容量挑选，
+// 尺寸不同但容量够用时通过 mxSetDimensions 复用，避免每次调用都分配和释放。
+#include "matrix.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+class HMatlabMxPool
+{
+public:
+	HMatlabMxPool();
+	~HMatlabMxPool();
+
+	// 取出一个 rows x cols 的数组，内容未初始化；失败返回 NULL
+	mxArray *Acquire(mxClassID cls, mxComplexity complexity, size_t rows, size_t cols);
+	// 归还 Acquire 得到的数组，超过内存上限时直接销毁
+	void Release(mxArray *A);
+	// 销毁所有空闲数组（引擎关闭时调用）
+	void Clear();
+
+	size_t MaxBytes();
+	void SetMaxBytes(size_t max_bytes);
+	uint64_t Hits();
+	uint64_t Misses();
+	size_t IdleBytes();
+	size_t InUseBytes();
+	size_t HighWaterBytes();
+
+private:
+	struct Slot
+	{
+		mxArray *A;
+		size_t capacity; // 数据区字节数
+		int key;
+	};
+
+	static int Key(mxClassID cls, mxComplexity complexity);
+	void TrimLocked();
+
+	std::mutex mutex_;
+	// 每组空闲数组按容量排序，便于找“够用的最小”那个
+	std::map<int, std::multimap<size_t, Slot> > idle_;
+	std::unordered_map<mxArray *, Slot> in_use_;
+	size_t max_bytes_;
+	size_t idle_bytes_;
+	size_t in_use_bytes_;
+	size_t high_water_bytes_;
+	uint64_t hits_;
+	uint64_t misses_;
+};
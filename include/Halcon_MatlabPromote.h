@@ -0,0 +1,54 @@
+#pragma once
+// 热点 eval 文本自动提升为生成的脚本文件：MATLAB 每次 engEvalString 都要重新解析文本，
+// 而脚本文件只解析一次并由 JIT 缓存。文本中的数值字面量被抽成参数 hm_p__(k)，
+// 只差数值的多条语句共用同一个生成文件。
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 把脚本里的数值字面量换成 hm_p__(k)。params 得到 "v1,v2,..."（保留原始写法）。
+// 含命令语法、clear 等无法安全改写的文本返回 false。
+bool HMatlabExtractTemplate(const std::string &script, std::string *templ, std::string *params);
+
+// 放进 MATLAB 单引号字符串里的文本：单引号写两遍
+std::string HMatlabQuote(const std::string &text);
+
+// 本进程放生成文件的临时目录 (不存在时创建)，以路径分隔符结尾
+std::string HMatlabPrivateDir();
+
+class HMatlabPromoter
+{
+public:
+	HMatlabPromoter();
+
+	// 返回实际要交给引擎执行的文本；未达到提升条件时原样返回
+	std::string Rewrite(const std::string &script);
+	// 引擎关闭时调用：删除生成的文件并清空统计
+	void Reset();
+
+	size_t Threshold();
+	void SetThreshold(size_t threshold);
+	uint64_t Hits();
+	size_t Promoted();
+	size_t Candidates();
+
+private:
+	struct Entry
+	{
+		size_t count;
+		std::string func; // 非空表示已经生成了脚本文件
+	};
+
+	bool WriteScript(const std::string &func, const std::string &templ);
+
+	std::mutex mutex_;
+	std::unordered_map<std::string, Entry> entries_;
+	std::vector<std::string> files_;
+	std::string dir_;
+	bool path_added_;
+	size_t threshold_;
+	uint64_t hits_;
+};
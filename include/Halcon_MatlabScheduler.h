@@ -0,0 +1,41 @@
+#pragma once
+// Matlab_engFeval 的 'schedule' 为 'pool' 时使用的任务调度：会话池里每个引擎一个调度线程和
+// 一个双端队列。任务放进提交线程所在会话的队列；调度线程从自己队列的队头取任务，空闲时
+// 从别的队列的队尾偷任务，一个引擎上的长任务不会挡住排在它后面的任务。
+// 任务应当不依赖工作区状态；依赖的变量在 vars 里声明，在别的引擎上执行前从提交方的会话
+// 复制过去 (save 成 MAT 文件再 load)，来源会话的 revision 没变时沿用上次的 MAT 文件。
+// 复制过去的变量只在任务执行期间存在，执行完还原目标引擎上原有的同名变量；
+// 复制失败的任务改回提交方自己的引擎上执行。引擎在调度线程第一次拿到任务时才打开。
+// 任务按提交线程的优先级分队列，调度线程先取高优先级的任务；可以保留几个引擎只执行 high
+// (以及自己队列里复制失败、只能在它上面执行的任务)。
+// 任务在提交线程的工作区命名空间里执行，vars 也按命名空间复制。
+#include "Halcon_Matlab.h"
+#include "Halcon_MatlabSession.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 在池里某个引擎上执行 fn 并等待完成，调度线程已经持有该引擎的 HMatlabEngineScope。
+// 返回 fn 的结果；fn 抛出的异常在调用线程重新抛出；没有可用引擎时返回 H_ERR_MATLAB_ENGINE
+Herror HMatlabSchedule(HMatlabSession &source, const std::vector<std::string> &vars,
+					   const std::function<Herror(HMatlabSession &)> &fn);
+// 异步版本：复制一份参数放进队列后立即返回，任务结束时在调度线程上调用 finish(结果)，
+// fn 抛出异常时结果为 H_ERR_MATLAB_ENGINE。变量名不合法或没有可用引擎时在调用线程上直接调用 finish
+void HMatlabSchedulePost(HMatlabSession &source, const std::vector<std::string> &vars,
+						 const std::function<Herror(HMatlabSession &)> &fn, const std::function<void(Herror)> &finish);
+
+// 统计：任务数、被偷走执行的任务数、变量复制次数、任务在队列里等待的时间 (微秒)
+uint64_t HMatlabSchedulerJobs();
+uint64_t HMatlabSchedulerSteals();
+uint64_t HMatlabSchedulerReplications();
+uint64_t HMatlabSchedulerWaitUs();
+uint64_t HMatlabSchedulerWaitMaxUs();
+// 按优先级分开的任务数和等待时间
+uint64_t HMatlabSchedulerJobs(HMatlabPriority priority);
+uint64_t HMatlabSchedulerWaitUs(HMatlabPriority priority);
+uint64_t HMatlabSchedulerWaitMaxUs(HMatlabPriority priority);
+// 序号最大的 engines 个引擎只执行 high 任务 (至少留一个引擎执行其他任务)
+void HMatlabSchedulerSetReserved(size_t engines);
+size_t HMatlabSchedulerReserved();
+void HMatlabSchedulerResetStats();
@@ -0,0 +1,177 @@
+#pragma once
+// 一个 MATLAB 引擎会话及其附属状态，从 Matlab_engOpen 到 Matlab_engClose
+#include "engine.h"
+#include "Halcon_MatlabPool.h"
+#include "Halcon_MatlabPromote.h"
+#include "Halcon_MatlabWorker.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Matlab_engPutImage 只传定义域外接矩形 ('bbox') 或定义域内像素 ('domain') 时记下的
+// 原图信息，Matlab_engGetImage 据此把结果贴回原尺寸、原定义域的图像
+struct HMatlabImageRoi
+{
+	std::string mode; // "bbox" 或 "domain"
+	size_t width, height; // 原图尺寸
+	size_t row0, col0, rows, cols; // 外接矩形，从 0 开始
+	size_t count; // 定义域像素数
+	std::vector<int64_t> runs; // 定义域行程，每三个一组：行、起始列、结束列
+};
+
+// Matlab_engUpdateImage 上次上传的图像：尺寸、类型和每个块的哈希，按行优先排列
+struct HMatlabImageTiles
+{
+	size_t width, height, channels, tile;
+	int kind;
+	std::vector<uint64_t> hashes;
+};
+
+// 通过扩展写入 / 读出的用户变量：写入时的大小，最近一次写入和读出是第几次算子调用 (0 表示没有)
+struct HMatlabTrackedVar
+{
+	HMatlabTrackedVar() : bytes(0), written(0), read(0) {}
+	uint64_t bytes;
+	uint64_t written, read;
+};
+
+static const size_t kHMatlabMaxBatchErrors = 4096;
+
+struct HMatlabSession
+{
+	HMatlabSession()
+		: ep(NULL), revision(0), deferred(false), batch_max(64), eval_label(0), eval_seq(0), flushes(0), batched(0),
+		  put_batch_max_member_bytes((size_t)16 << 20), put_int64(false), chunk_bytes(0), comp_threads(-1), core_mask(0),
+		  profile("desktop"), single_thread(false), startup_us(0), namespace_path(false), pid(0),
+		  auto_clear(false), soft_limit(0), hard_limit(0), check_interval(16), calls(0), call_depth(0),
+		  consumed(0), auto_cleared(0), soft_cleanups(0), recycles(0), recycle_failures(0), last_resident(0) {}
+
+	Engine *ep;
+	// 所有 eng* 调用都在 worker 线程上执行；算子用 HMatlabEngineScope 独占后再读写下面的状态
+	HMatlabWorker worker;
+	HMatlabMxPool pool;
+	HMatlabPromoter promoter;
+	// 工作区的修改版本：每次 eval 和 put 用户变量加一，内部临时变量 hm_*__ 不算
+	uint64_t revision;
+
+	// 延迟模式：eval 先缓冲，需要结果或显式 flush 时合并成一次 engEvalString
+	bool deferred;
+	size_t batch_max;
+	std::vector<std::string> pending;
+	// pending 中每条语句是第几次 Matlab_engEvalString (从上次 Matlab_engFlush 报告后算起，
+	// 从 1 开始)，扩展自己生成的语句为 0。eval_label 由 Matlab_engEvalString 在 eval 前设置
+	std::vector<size_t> pending_label;
+	size_t eval_label;
+	size_t eval_seq;
+	// 待清理的内部临时变量，clear 语句附在下一次发给引擎的 eval 前面，不单独占一次往返
+	std::vector<std::string> cleanup;
+	// 出错的语句 (序号同 pending_label) 和错误信息。自动 flush 的错误也累积在这里，
+	// 直到 Matlab_engFlush 取走；最多保留 kHMatlabMaxBatchErrors 条
+	std::vector<size_t> error_index;
+	std::vector<std::string> error_message;
+	uint64_t flushes;
+	uint64_t batched;
+
+	// Matlab_engPutVariable 中超过该大小的矩阵不打进结构体，单独上传
+	size_t put_batch_max_member_bytes;
+	// 全是整数的元组上传成 int64 (put_integer_class 为 'int64')，默认和以前一样是 double
+	bool put_int64;
+	// Matlab_engPutImage / Matlab_engGetImage 中超过该大小的图像按列分片传输，
+	// 在 MATLAB 端写进预先分配的数组；0 表示不分片
+	size_t chunk_bytes;
+
+	// 按 MATLAB 变量名记录，多个图像对象时每个元胞元素一项
+	std::map<std::string, std::vector<HMatlabImageRoi> > image_rois;
+	std::map<std::string, HMatlabImageTiles> image_tiles;
+
+	// CPU 划分：MATLAB 的计算线程数 (-1 不设置，0 恢复自动) 和引擎进程绑定的核 (0 不绑定)。
+	// 引擎打开时自动应用；别的线程会读取它们来推算 HALCON 的线程数
+	std::atomic<int> comp_threads;
+	std::atomic<uint64_t> core_mask;
+
+	// 启动配置 (见 HMatlabSetStartup) 和最近一次打开引擎的耗时
+	std::string profile;
+	std::string startcmd;
+	bool single_thread;
+	uint64_t startup_us;
+
+	// 引擎的路径里是否已经有 hm_ns_exec__ (见 Halcon_MatlabNamespace.h)
+	bool namespace_path;
+	// 引擎进程的 pid (0 表示还没查过)
+	int64_t pid;
+
+	// 工作区治理 (见 Halcon_MatlabWorkspace.h)：临时变量名、按 (命名空间, 变量名) 记录的变量、
+	// 内存限制 (引擎进程的常驻内存，字节，0 表示不限) 和检查间隔 (算子调用次数)
+	bool auto_clear;
+	std::set<std::string> transient;
+	std::map<std::pair<std::string, std::string>, HMatlabTrackedVar> tracked;
+	uint64_t soft_limit, hard_limit;
+	size_t check_interval;
+	// 算子调用计数、嵌套深度、最近一次执行用户代码的调用
+	uint64_t calls;
+	int call_depth;
+	uint64_t consumed;
+	uint64_t auto_cleared, soft_cleanups, recycles, recycle_failures, last_resident;
+};
+
+// 调用线程的当前会话。亲和模式为 'none' (默认) 时所有线程共用默认会话；
+// 为 'thread' 时每个线程第一次调用时从会话池里绑定一个空闲会话并按需打开引擎，
+// 池满后和绑定线程最少的会话共用 (会话内部由 HMatlabEngineScope 串行化)。
+// 线程退出时解除绑定，会话和引擎留在池里给后来的线程。
+HMatlabSession &HMatlabGetSession();
+
+// 亲和模式和会话池。切回 'none' 时关闭池里除默认会话外的引擎，所有绑定失效
+void HMatlabSetThreadAffinity(bool per_thread);
+bool HMatlabThreadAffinity();
+// 池里最多的会话数 (含默认会话)，只限制之后新建的会话
+void HMatlabSetEnginePoolSize(size_t size);
+size_t HMatlabEnginePoolSize();
+// 池里第 index 个会话，不存在时新建 (沿用默认会话的设置，不打开引擎)
+HMatlabSession &HMatlabPoolSession(size_t index);
+// 已建的会话数、会话在池里的序号 (默认会话为 0)、池满后共用会话的绑定次数
+size_t HMatlabEngineCount();
+size_t HMatlabSessionIndex(const HMatlabSession &session);
+uint64_t HMatlabSharedBinds();
+
+// 引擎的启动配置，下次打开引擎时生效：
+//   desktop   - engOpen(NULL)，和以前相同
+//   nodesktop - -nodesktop -nosplash
+//   compute   - 再加 -nodisplay -nojvm，不能画图，启动最快、内存最少
+//   single    - compute 再加 -singleCompThread
+// options 附加在命令行后面，command 是 MATLAB 的启动命令 (默认 matlab)。
+// Windows 上引擎通过 COM 启动，engOpen 忽略 startcmd，只接受 desktop、不带 options 和
+// command；其他配置返回 false，不假装生效。单计算线程可以用 'comp_threads' 设置
+bool HMatlabSetStartup(HMatlabSession &session, const std::string &profile, const std::string &options,
+					   const std::string &command);
+// profile 是否为上面四种之一 (Windows 上只有 desktop)
+bool HMatlabIsStartupProfile(const std::string &profile);
+// 打开 / 关闭会话的引擎，调用方持有该会话的 HMatlabEngineScope。
+// 关闭时先执行缓冲的语句，并清空数组池、提升记录和图像记录
+bool HMatlabOpenEngine(HMatlabSession &session);
+void HMatlabCloseEngine(HMatlabSession &session);
+// 把 comp_threads、core_mask 应用到已打开的引擎上，调用方持有该会话的 scope
+bool HMatlabApplyCpuSettings(HMatlabSession &session);
+// 引擎进程的 pid (MATLAB 的 feature('getpid'))，取不到时返回 0
+int64_t HMatlabEnginePid(HMatlabSession &session);
+// 建议的 HALCON thread_num：逻辑核数减去各引擎占用的核 (绑定的核，或者只限制了
+// 计算线程数时的线程数)；既没绑核也没限线程的引擎不计
+size_t HMatlabRecommendedThreadNum();
+// 关闭池里除默认会话外的所有引擎，并使所有线程绑定失效
+void HMatlabClosePooledEngines();
+
+// 引擎访问统一走下面几个函数：除 HMatlabEval 外都会先 flush 缓冲的语句，
+// 保证和立即模式相同的执行顺序。返回值与对应的 eng* 函数一致。
+// 调用线程设置了工作区命名空间时，语句在命名空间里执行，用户变量读写命名空间的结构体
+int HMatlabEval(HMatlabSession &session, const char *cmd);
+int HMatlabEvalNow(HMatlabSession &session, const char *cmd);
+// engEvalString 只在引擎断开时返回非 0，语句在 MATLAB 里出错并不报告。需要知道语句是否
+// 执行完时用它：cmd 包在 try/catch 里立即执行，再取回标志变量 hm_ok__，执行完返回 true
+bool HMatlabEvalChecked(HMatlabSession &session, const char *cmd);
+int HMatlabPutVariable(HMatlabSession &session, const char *name, const mxArray *A);
+mxArray *HMatlabGetVariable(HMatlabSession &session, const char *name);
+int HMatlabFlush(HMatlabSession &session);
+// 登记一个用完的临时变量，随下一次 eval 一起 clear；在此之前再次 put 同名变量会取消登记
+void HMatlabClearLater(HMatlabSession &session, const char *name);
@@ -0,0 +1,49 @@
+#pragma once
+// 传输层的下标、字节数计算。全部按 size_t 进行，HALCON XL 的大图和超过 2^31 个元素的
+// MATLAB 数组不会在中途溢出。下面的 static_assert 只检查这几个算式本身在晶圆级尺寸下的结果，
+// 不覆盖 HMatlabMxPool::Acquire、Transpose/TransposeBlocked 和 MxImageType 的实际代码路径；
+// 这些路径在超过 2^31 个元素时还没有端到端测试 (本仓库没有测试工程，需要 XL 版 HALCON 和 MATLAB)。
+#include <cstddef>
+#include <cstdint>
+
+// 按行存放 (HALCON) 的元素下标，stride 是行距
+constexpr size_t HMatlabRowMajorIndex(size_t row, size_t col, size_t stride)
+{
+	return row * stride + col;
+}
+
+// 按列存放 (MATLAB) 的元素下标，stride 是列距
+constexpr size_t HMatlabColumnMajorIndex(size_t row, size_t col, size_t stride)
+{
+	return col * stride + row;
+}
+
+// 第 plane 个通道 (每通道 rows x cols 个元素，每个 bytes 字节) 的起始字节偏移
+constexpr size_t HMatlabPlaneOffset(size_t plane, size_t rows, size_t cols, size_t bytes)
+{
+	return plane * rows * cols * bytes;
+}
+
+// rows * cols * bytes 是否放得进 size_t；bytes 为 0 时视为放不下
+constexpr bool HMatlabBytesFit(size_t rows, size_t cols, size_t bytes)
+{
+	return bytes != 0 && (rows == 0 || cols <= SIZE_MAX / bytes / rows);
+}
+
+static_assert(HMatlabBytesFit(0, SIZE_MAX, 8), "empty arrays always fit");
+static_assert(!HMatlabBytesFit(1, 1, 0), "unknown element size");
+static_assert(!HMatlabBytesFit(SIZE_MAX / 2, 3, 1), "overflowing byte count must be rejected");
+
+#if SIZE_MAX > 0xFFFFFFFFu
+// 64 位：60000 x 60000 的三通道 int4 图像，共 1.08e10 个元素、4.32e10 字节
+static_assert(HMatlabBytesFit(60000, 60000, 4), "wafer-sized plane must fit");
+static_assert(HMatlabRowMajorIndex(59999, 59999, 60000) == 3599999999ull, "row-major index past 2^31");
+static_assert(HMatlabColumnMajorIndex(59999, 59999, 60000) == 3599999999ull, "column-major index past 2^31");
+static_assert(HMatlabColumnMajorIndex(1, 40000, 60000) == 2400000001ull, "column stride past 2^31");
+static_assert(HMatlabPlaneOffset(2, 60000, 60000, 4) == 28800000000ull, "channel offset past 2^32");
+static_assert(HMatlabBytesFit((size_t)1 << 31, 2, 8), "2^32 doubles must fit");
+#else
+// 32 位：超过地址空间的数组在分配前就被拒绝
+static_assert(!HMatlabBytesFit(60000, 60000, 4), "wafer-sized plane cannot fit a 32-bit address space");
+static_assert(HMatlabBytesFit(16384, 16384, 8), "2^28 doubles fit");
+#endif
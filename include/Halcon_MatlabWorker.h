@@ -0,0 +1,110 @@
+#pragma once
+// 每个会话一个引擎工作线程：所有 eng* 调用都在这个线程上执行，调用方通过无锁的
+// 多生产者单消费者队列提交任务并等待完成。MATLAB 引擎的连接因此只在一个线程上使用，
+// 和 HALCON 的哪个线程调用算子无关。
+// 一个算子里的多次引擎访问 (先 eval 再取变量、共用临时变量等) 用 HMatlabEngineScope
+// 包起来：持有期间工作线程只执行持有线程提交的任务，其他线程的任务按到达顺序排在后面，
+// 相当于一把先来先服务的锁。会话里的其他状态也只在持有期间修改。
+// 等待中的任务和独占请求按提交线程的优先级排队，同一优先级内先来先服务。
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+// 任务优先级：检测判定等关键任务用 high，绘图、报表等用 background。
+// 优先级跟随提交任务的线程 (Matlab_engSetParam 的 'job_priority')，只决定排队顺序，
+// 正在执行的任务和已经持有的独占不会被打断
+enum HMatlabPriority
+{
+	kHMatlabPriorityHigh = 0,
+	kHMatlabPriorityNormal = 1,
+	kHMatlabPriorityBackground = 2,
+	kHMatlabPriorityCount = 3
+};
+
+HMatlabPriority HMatlabThreadPriority();
+void HMatlabSetThreadPriority(HMatlabPriority priority);
+bool HMatlabParsePriority(const std::string &name, HMatlabPriority *priority);
+const char *HMatlabPriorityName(HMatlabPriority priority);
+
+// 在作用域内临时改变调用线程的优先级
+class HMatlabPriorityGuard
+{
+public:
+	explicit HMatlabPriorityGuard(HMatlabPriority priority) : saved_(HMatlabThreadPriority())
+	{
+		HMatlabSetThreadPriority(priority);
+	}
+	~HMatlabPriorityGuard() { HMatlabSetThreadPriority(saved_); }
+
+private:
+	HMatlabPriorityGuard(const HMatlabPriorityGuard &);
+	HMatlabPriorityGuard &operator=(const HMatlabPriorityGuard &);
+
+	HMatlabPriority saved_;
+};
+
+class HMatlabWorker
+{
+public:
+	HMatlabWorker();
+	~HMatlabWorker();
+
+	// 在工作线程上执行 fn 并等待完成，fn 抛出的异常在调用线程重新抛出。
+	// 已经在工作线程上时直接执行
+	void Run(const std::function<void()> &fn);
+	// 把 fn 放进队列后立即返回，不等待完成，fn 抛出的异常被丢弃。fn 在工作线程上执行，
+	// 里面的 HMatlabEngineScope 不再排队 (执行期间工作线程只做这一件事)
+	void Post(const std::function<void()> &fn);
+
+	// 独占工作线程，同一线程内可嵌套，Release 次数要和 Acquire 相同
+	void Acquire();
+	void Release();
+
+	// 竞争统计：任务数、任务在队列里等待的时间、独占次数、需要等待别的线程的独占次数
+	// 及等待时间 (微秒)、队列最大深度。带优先级参数的只统计该优先级的独占
+	uint64_t Jobs() const;
+	uint64_t QueueWaitUs() const;
+	uint64_t QueueWaitMaxUs() const;
+	uint64_t Scopes() const;
+	uint64_t ScopesContended() const;
+	uint64_t ScopeWaitUs() const;
+	uint64_t ScopeWaitMaxUs() const;
+	uint64_t Scopes(HMatlabPriority priority) const;
+	uint64_t ScopeWaitUs(HMatlabPriority priority) const;
+	uint64_t ScopeWaitMaxUs(HMatlabPriority priority) const;
+	uint64_t QueueDepthMax() const;
+	void ResetStats();
+
+private:
+	struct Job;
+	struct State;
+
+	HMatlabWorker(const HMatlabWorker &);
+	HMatlabWorker &operator=(const HMatlabWorker &);
+
+	void Start();
+	void Enqueue(Job *job);
+	void Submit(Job *job);
+	static void Loop(std::shared_ptr<State> state);
+
+	// 线程只持有 State 的 shared_ptr，进程退出时 HMatlabWorker 先析构也不会悬空
+	std::shared_ptr<State> state_;
+	std::thread thread_;
+};
+
+// 算子内独占引擎，作用域结束时释放
+class HMatlabEngineScope
+{
+public:
+	explicit HMatlabEngineScope(HMatlabWorker &worker) : worker_(worker) { worker_.Acquire(); }
+	~HMatlabEngineScope() { worker_.Release(); }
+
+private:
+	HMatlabEngineScope(const HMatlabEngineScope &);
+	HMatlabEngineScope &operator=(const HMatlabEngineScope &);
+
+	HMatlabWorker &worker_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+// 工作区治理：长时间运行的会话里临时变量和图窗越积越多，MATLAB 开始换页，节拍变慢。
+// - 记录通过扩展写入 / 读出的用户变量 (按命名空间区分) 及写入时的大小
+// - 声明为临时 (workspace_transient) 的变量用过一次就清掉：写入的变量在之后某次调用执行了
+//   用户代码 (Matlab_engEvalString / Matlab_engFeval) 后清掉，读出的变量在读出的那次调用结束时
+//   清掉。扩展自己的临时变量 hm_*__ 附在这些 clear 语句上一起清掉，没有时留到下一条语句
+// - 每隔 check_interval 次调用检查一次引擎进程的常驻内存：超过软限制时清掉所有临时变量、
+//   残留的 hm_*__ 和图窗；超过硬限制时关闭并重新打开引擎 (工作区全部丢失，搜索路径和当前
+//   目录恢复成关闭前的)。检查在算子成功返回之后进行，之后的算子不会报错，用户变量却已经
+//   没有了：设置 workspace_hard_limit 的程序要能重新生成自己的变量，或者用
+//   workspace_recycles 计数判断是否发生过回收
+#include "Halcon_MatlabSession.h"
+#include <set>
+#include <string>
+#include <vector>
+
+// 算子调用：独占会话的引擎，最外层的调用结束时做上面的清理和检查
+class HMatlabCallScope
+{
+public:
+	explicit HMatlabCallScope(HMatlabSession &session) : session_(session), scope_(session.worker)
+	{
+		session_.call_depth++;
+	}
+	~HMatlabCallScope();
+
+private:
+	HMatlabCallScope(const HMatlabCallScope &);
+	HMatlabCallScope &operator=(const HMatlabCallScope &);
+
+	HMatlabSession &session_;
+	HMatlabEngineScope scope_;
+};
+
+// 记录调用线程的命名空间里通过扩展写入 / 读出的用户变量，调用方持有会话的 scope
+void HMatlabNoteWrite(HMatlabSession &session, const std::string &name, uint64_t bytes);
+void HMatlabNoteRead(HMatlabSession &session, const std::string &name);
+// 本次调用执行了用户代码，之前写入的临时变量算作用过
+void HMatlabNoteConsume(HMatlabSession &session);
+// mxArray 数据部分的大小，结构体和元胞只算自身
+uint64_t HMatlabMxBytes(const mxArray *A);
+
+// 合法的 MATLAB 变量名：字母开头，只含字母、数字和下划线
+bool HMatlabIsVarName(const std::string &name);
+// 'U,I,CC' 形式的变量名列表；有不合法的名字时返回 false
+bool HMatlabParseNameList(const std::string &text, std::set<std::string> *names);
+std::string HMatlabFormatNameList(const std::set<std::string> &names);
+
+// 软限制的清理和硬限制的回收，也可以直接调用。调用方持有会话的 scope。
+// 回收时引擎打不开或者没能恢复搜索路径、当前目录都返回 false
+bool HMatlabWorkspaceCleanup(HMatlabSession &session);
+bool HMatlabRecycleEngine(HMatlabSession &session);
+
+// 调用线程所在工作区 (或命名空间) 的变量、类型和字节数 (whos)，不含扩展的临时变量
+bool HMatlabWorkspaceInfo(HMatlabSession &session, std::vector<std::string> *names,
+						  std::vector<std::string> *classes, std::vector<uint64_t> *bytes);
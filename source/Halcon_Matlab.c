@@ -57,3 +57,145 @@ Herror CHMatlab_engSetmxArray(Hproc_handle proc_handle)
 
 
 }
+
+
+Herror CHMatlab_engFeval(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engFeval( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engSetParam(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engSetParam( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetParam(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetParam( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engFlush(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engFlush( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engPutRegion(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engPutRegion( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetRegion(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetRegion( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engPutXLD(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engPutXLD( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetXLD(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetXLD( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engSetSparse(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engSetSparse( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetSparse(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetSparse( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engPutImage(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engPutImage( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetImage(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetImage( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engSetComplexArray(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engSetComplexArray( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engGetComplexArray(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engGetComplexArray( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engUpdateSubarray(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engUpdateSubarray( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engUpdateImage(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engUpdateImage( proc_handle);
+
+
+}
+
+
+Herror CHMatlab_engWorkspaceInfo(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engWorkspaceInfo( proc_handle);
+
+
+}
+Herror CHMatlab_engOpenParam(Hproc_handle proc_handle)
+{
+	return 	HMatlab_engOpenParam( proc_handle);
+
+
+}
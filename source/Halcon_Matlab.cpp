@@ -4,6 +4,28 @@
 #include "stdio.h"
 #include "engine.h"
 #include "Halcon_Matlab.h"
+#include "Halcon_MatlabBatch.h"
+#include "Halcon_MatlabCache.h"
+#include "Halcon_MatlabDeadline.h"
+#include "Halcon_MatlabConvert.h"
+#include "Halcon_MatlabCpu.h"
+#include "Halcon_MatlabNamespace.h"
+#include "Halcon_MatlabParam.h"
+#include "Halcon_MatlabScheduler.h"
+#include "Halcon_MatlabSession.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifndef __APPLE__
 #include "HalconCpp.h"
@@ -26,7 +48,6 @@
 using namespace HalconCpp;
 static char p[1024];
 
-Engine *ep;
 // extern "C"
 // {
 // #define H_MATLAB_ENGINE_TAG 0xC0FFEE10
@@ -61,13 +82,86 @@ Herror HMatlab_engOpen(Hproc_handle proc_handle)
     //HCkP(HAlloc(proc_handle, sizeof(HUserHandleData), (void**)handle_data));
 
     //(*handle_data)->
-	ep = engOpen(NULL);
+	// 亲和模式下绑定会话时已经打开了引擎，已打开的不再重复打开
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabEngineScope scope(session.worker);
+	if (session.ep == NULL)
+	{
+		HMatlabOpenEngine(session);
+	}
     //if (!(*handle_data)->ep) {
     //    return H_ERR_WIPV1;  // 或自定义错误码
     //}
 	//ep =(*handle_data)->ep;//这个后面要删掉
     return H_MSG_TRUE;
 }
+
+// 按启动配置打开引擎 (见 HMatlabSetStartup)：'profile'、'options' (附加的命令行选项)、'command'。
+// Matlab_engOpen 不带参数，保持原来的接口；打不开时这里报错
+Herror HMatlab_engOpenParam(Hproc_handle proc_handle)
+{
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_name, num_value;
+	HGetPPar(proc_handle, 1, &GenParamName, &num_name);
+	HGetPPar(proc_handle, 2, &GenParamValue, &num_value);
+	if (num_name != num_value)
+	{
+		return H_ERR_WIPN2;
+	}
+	std::string profile = "desktop", options, command = "matlab";
+	for (INT4_8 i = 0; i < num_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR || GenParamValue[i].type != STRING_PAR)
+		{
+			return GenParamName[i].type != STRING_PAR ? H_ERR_WIPT1 : H_ERR_WIPT2;
+		}
+		std::string name = GenParamName[i].par.s;
+		if (name == "profile")
+		{
+			profile = GenParamValue[i].par.s;
+			if (!HMatlabIsStartupProfile(profile))
+			{
+				return H_ERR_WIPV2;
+			}
+		}
+		else if (name == "options")
+		{
+			options += (options.empty() ? "" : " ") + std::string(GenParamValue[i].par.s);
+		}
+		else if (name == "command")
+		{
+			command = GenParamValue[i].par.s;
+			if (command.empty())
+			{
+				return H_ERR_WIPV2;
+			}
+		}
+		else
+		{
+			return H_ERR_WIPV1;
+		}
+	}
+	// 亲和模式下绑定会话时已经按默认会话的配置打开了引擎，已打开的不再重复打开。
+	// 这时给出的启动参数不会生效，报错而不是悄悄忽略
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabEngineScope scope(session.worker);
+	if (session.ep != NULL && num_name > 0)
+	{
+		return H_ERR_MATLAB_OPEN;
+	}
+	if (session.ep == NULL)
+	{
+		if (!HMatlabSetStartup(session, profile, options, command))
+		{
+			return H_ERR_WIPV2;
+		}
+		if (!HMatlabOpenEngine(session))
+		{
+			return H_ERR_MATLAB_ENGINE;
+		}
+	}
+	return H_MSG_TRUE;
+}
 // static Herror HUserHandleCreate(Hproc_handle ph, HUserHandleData** user_handle)
 // {
 //   HUserHandleData* uh;
@@ -89,7 +183,16 @@ Herror HMatlab_engClose(Hproc_handle proc_handle)
     //HUserHandleData *handle_data;
     //HGetCElemH1(proc_handle, 1, &HandleTypeUser, &handle_data);
     // HALCON 会自动调用析构函数释放句柄
-	 engClose(ep);
+	HMatlabSession &session = HMatlabGetSession();
+	{
+		HMatlabEngineScope scope(session.worker);
+		HMatlabCloseEngine(session);
+	}
+	// 默认会话收尾时，亲和模式下池里的引擎一起关闭
+	if (HMatlabSessionIndex(session) == 0)
+	{
+		HMatlabClosePooledEngines();
+	}
     return H_MSG_TRUE;
 }
 
@@ -106,7 +209,13 @@ Herror HMatlab_engEvalString(Hproc_handle proc_handle)
     HGetSPar(proc_handle, 1, STRING_PAR, &MatlabString, 1);
 
     // 执行 MATLAB 命令
-    int ret = engEvalString(ep, MatlabString.par.s);
+    // 反复出现的文本会改写成生成脚本的调用；延迟模式下只是放进缓冲区
+    HMatlabSession &session = HMatlabGetSession();
+    HMatlabCallScope scope(session);
+    std::string cmd = session.promoter.Rewrite(MatlabString.par.s);
+    HMatlabNoteConsume(session);
+    session.eval_label = ++session.eval_seq;
+    int ret = HMatlabEval(session, cmd.c_str());
     if (ret != 0) {
         return H_ERR_WIPV2;  // 或自定义错误码
     }
@@ -118,6 +227,15 @@ Herror HMatlab_engOutputBuffer(Hproc_handle proc_handle)
 {
 	Hcpar BufferSize;
 
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	Engine *ep = session.ep;
+	// 缓冲的语句执行完，输出才完整
+	if (HMatlabFlush(session) != 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
 	HAllocStringMem(proc_handle, 1024);
 	HGetSPar(proc_handle, 1, LONG_PAR, &BufferSize, 1);
 	if (BufferSize.par.l > 1024)
@@ -134,29 +252,30 @@ Herror HMatlab_engOutputBuffer(Hproc_handle proc_handle)
 		HPutElem(proc_handle, 1, &pp, 1, STRING_PAR);
 		return H_MSG_TRUE;
 	}
-	else if (BufferSize.par.l == 0)
-	{
-		return engOutputBuffer(ep, NULL, 0) + H_MSG_TRUE;
-	}
 	else
 	{
-		return engOutputBuffer(ep, p, BufferSize.par.l) + H_MSG_TRUE;
+		// 缓冲区 p 由引擎在工作线程上写入
+		int ret = 0;
+		session.worker.Run([&]() { ret = engOutputBuffer(ep, BufferSize.par.l == 0 ? NULL : p, (int)BufferSize.par.l); });
+		return ret + H_MSG_TRUE;
 	}
 }
 
 Herror HMatlab_engSetVisible(Hproc_handle proc_handle)
 {
 	Hcpar Visible;
-	// HAllocStringMem(proc_handle, 1024);
-	HGetSPar(proc_handle, 1, LONG_PAR, &Visible, 1);
-	if (Visible.par.l == 1)
-	{
-		return engSetVisible(ep, true) + H_MSG_TRUE;
-	}
-	else
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	Engine *ep = session.ep;
+	if (HMatlabFlush(session) != 0)
 	{
-		return engSetVisible(ep, false) + H_MSG_TRUE;
+		return H_ERR_MATLAB_ENGINE;
 	}
+	// HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, LONG_PAR, &Visible, 1);
+	int ret = 0;
+	session.worker.Run([&]() { ret = engSetVisible(ep, Visible.par.l == 1); });
+	return ret + H_MSG_TRUE;
 }
 
 Herror HMatlab_engSetmxArray(Hproc_handle proc_handle)
@@ -172,53 +291,440 @@ Herror HMatlab_engSetmxArray(Hproc_handle proc_handle)
 	Hcpar  *hv_VAL;
 	INT4_8 num_params;
 	HGetPPar(proc_handle, 4, &hv_VAL, &num_params);
-	if(num_params!= hv_M.par.l* hv_N.par.l)
+	if (hv_M.par.l < 0 || hv_N.par.l < 0)
+	{
+		return H_ERR_WIPV1;
+	}
+	// 元素个数按 size_t 计算，超过 2^31 的矩阵不会溢出
+	size_t m = (size_t)hv_M.par.l;
+	size_t n = (size_t)hv_N.par.l;
+	if ((size_t)num_params != m * n)
 	{
 		return H_ERR_WIPT4; // 错误代码：控制参数数量与矩阵大小不匹配
 	}
 
-
-
-
-	mxArray *xx = mxCreateDoubleMatrix(hv_M.par.l, hv_N.par.l, mxREAL);
-	for (INT4_8 i = 0; i < num_params; i++)
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	mxArray *xx = session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, m, n);
+	if (xx == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	double *pr = mxGetPr(xx);
+	for (size_t i = 0; i < (size_t)num_params; i++)
 	{
-		mxGetPr(xx)[i] = hv_VAL[i].par.d;
+		pr[i] = hv_VAL[i].type == LONG_PAR ? (double)hv_VAL[i].par.l : hv_VAL[i].par.d;
 	}
 
-	int ret = engPutVariable(ep, NAME.par.s, xx);
-	mxDestroyArray(xx);
+	int ret = HMatlabPutVariable(session, NAME.par.s, xx);
+	session.pool.Release(xx);
 	// free(value);
-	return H_MSG_TRUE;
+	return ret == 0 ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
 }
 Herror HMatlab_engGetmxArray(Hproc_handle proc_handle)
 {
 	HAllocStringMem(proc_handle, 32);
 	Hcpar NAME;
-	HTuple hv_MatrixID;
 	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
 
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
 	mxArray *A = NULL;
-	if ((A = engGetVariable(ep, NAME.par.s)) == NULL)
+	if ((A = HMatlabGetVariable(session, NAME.par.s)) == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	// 稀疏阵的 mxGetPr 只有非零元，按 M*N 读会越界；稀疏阵请用 Matlab_engGetSparse，
+	// 复数请用 Matlab_engGetComplexArray
+	if (!mxIsDouble(A) || mxIsComplex(A) || mxIsSparse(A))
+	{
+		mxDestroyArray(A);
+		return H_ERR_MATLAB_ENGINE;
+	}
+	// HPutElem 自己会复制，直接从 mxArray 写出，不再经过一块临时缓冲区。
+	// 个数用 mxGetNumberOfElements (size_t)，多维数组按 M x (其余各维之积) 给出
+	size_t num = mxGetNumberOfElements(A);
+	if (num > (size_t)(std::numeric_limits<INT4_8>::max)())
+	{
+		mxDestroyArray(A);
+		return H_ERR_MEM; // 32 位版本的元组放不下
+	}
+	INT4_8 m = (INT4_8)mxGetM(A);
+	INT4_8 n = (INT4_8)mxGetN(A);
+
+	HPutElem(proc_handle, 1, &m, 1, LONG_PAR);
+	HPutElem(proc_handle, 2, &n, 1, LONG_PAR);
+	HPutElem(proc_handle, 3, mxGetPr(A), (INT4_8)num, DOUBLE_PAR);
+
+	mxDestroyArray(A);
+
+	return H_MSG_TRUE;
+}
+
+// 只改写 MATLAB 里已有变量的一块：RowRange / ColRange 是 [起始, 结束] (从 0 开始，含两端)，
+// Values 按列存放。只上传这一块，在 MATLAB 里用下标赋值原地写入
+Herror HMatlab_engUpdateSubarray(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	Hcpar *RowRange, *ColRange, *Values;
+	INT4_8 num_row, num_col, num_values;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 2, &RowRange, &num_row);
+	HGetPPar(proc_handle, 3, &ColRange, &num_col);
+	HGetPPar(proc_handle, 4, &Values, &num_values);
+	if (num_row != 2)
+	{
+		return H_ERR_WIPN2;
+	}
+	if (num_col != 2)
+	{
+		return H_ERR_WIPN3;
+	}
+	if (RowRange[0].type != LONG_PAR || RowRange[1].type != LONG_PAR ||
+		RowRange[0].par.l < 0 || RowRange[1].par.l < RowRange[0].par.l)
+	{
+		return H_ERR_WIPV2;
+	}
+	if (ColRange[0].type != LONG_PAR || ColRange[1].type != LONG_PAR ||
+		ColRange[0].par.l < 0 || ColRange[1].par.l < ColRange[0].par.l)
+	{
+		return H_ERR_WIPV3;
+	}
+	size_t m = (size_t)(RowRange[1].par.l - RowRange[0].par.l + 1);
+	size_t n = (size_t)(ColRange[1].par.l - ColRange[0].par.l + 1);
+	if ((size_t)num_values != m * n)
+	{
+		return H_ERR_WIPN4;
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	mxArray *A = session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, m, n);
+	if (A == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	double *pr = mxGetDoubles(A);
+	for (size_t i = 0; i < (size_t)num_values; i++)
+	{
+		pr[i] = Values[i].type == LONG_PAR ? (double)Values[i].par.l : Values[i].par.d;
+	}
+	int ret = HMatlabPutVariable(session, "hm_sub__", A);
+	session.pool.Release(A);
+	char cmd[128];
+	snprintf(cmd, sizeof(cmd), "(%lld:%lld,%lld:%lld)=hm_sub__;", (long long)RowRange[0].par.l + 1,
+			 (long long)RowRange[1].par.l + 1, (long long)ColRange[0].par.l + 1, (long long)ColRange[1].par.l + 1);
+	// 命名空间里的变量直接改结构体的字段，原地赋值，不经过 hm_ns_exec__
+	std::string target = HMatlabNamespaceRef(NAME.par.s);
+	HMatlabNamespaceGuard base("");
+	if (ret != 0 || HMatlabEval(session, (target + cmd).c_str()) != 0)
 	{
-		return 9999;
+		return H_ERR_MATLAB_ENGINE;
 	}
-	double *C;
-	HAllocTmp(proc_handle, &C, (int)mxGetM(A) * (int)mxGetN(A) * sizeof(double));
+	HMatlabClearLater(session, "hm_sub__");
+	return H_MSG_TRUE;
+}
 
-	INT4_8 m = mxGetM(A);
-	INT4_8 n = mxGetN(A);
-	memcpy(C, mxGetPr(A), (int)mxGetM(A) * (int)mxGetN(A) * sizeof(double)); // 将数组x复制到mxarray数组xx中。
+// ---------------------------------------------------------------------------
+// 复数矩阵：实部、虚部各一个元组，按列存放 (与 Matlab_engSetmxArray 的 VAL 相同)。
+// 数据直接写进交错存放的 mxComplexDouble，不另建实部、虚部两个数组。
+Herror HMatlab_engSetComplexArray(Hproc_handle proc_handle)
+{
+	Hcpar hv_M, hv_N, NAME;
+	Hcpar *Re, *Im;
+	INT4_8 num_re, num_im;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, LONG_PAR, &hv_M, 1);
+	HGetSPar(proc_handle, 2, LONG_PAR, &hv_N, 1);
+	HGetSPar(proc_handle, 3, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 4, &Re, &num_re);
+	HGetPPar(proc_handle, 5, &Im, &num_im);
+	if (num_re != hv_M.par.l * hv_N.par.l)
+	{
+		return H_ERR_WIPN4;
+	}
+	if (num_im != num_re)
+	{
+		return H_ERR_WIPN5;
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	mxArray *A = session.pool.Acquire(mxDOUBLE_CLASS, mxCOMPLEX, hv_M.par.l, hv_N.par.l);
+	if (A == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	mxComplexDouble *v = mxGetComplexDoubles(A);
+	for (INT4_8 i = 0; i < num_re; i++)
+	{
+		v[i].real = Re[i].type == LONG_PAR ? (double)Re[i].par.l : Re[i].par.d;
+		v[i].imag = Im[i].type == LONG_PAR ? (double)Im[i].par.l : Im[i].par.d;
+	}
+	int ret = HMatlabPutVariable(session, NAME.par.s, A);
+	session.pool.Release(A);
+	return ret == 0 ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
+}
 
+// 实数矩阵也可以取，虚部为 0
+Herror HMatlab_engGetComplexArray(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	mxArray *A = HMatlabGetVariable(session, NAME.par.s);
+	if (A == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	if (!mxIsDouble(A) || mxIsSparse(A))
+	{
+		mxDestroyArray(A);
+		return H_ERR_MATLAB_ENGINE;
+	}
+	size_t num = mxGetNumberOfElements(A);
+	double *re, *im;
+	HAllocTmp(proc_handle, &re, num * sizeof(double) + 1);
+	HAllocTmp(proc_handle, &im, num * sizeof(double) + 1);
+	if (mxIsComplex(A))
+	{
+		const mxComplexDouble *v = mxGetComplexDoubles(A);
+		for (size_t i = 0; i < num; i++)
+		{
+			re[i] = v[i].real;
+			im[i] = v[i].imag;
+		}
+	}
+	else
+	{
+		memcpy(re, mxGetDoubles(A), num * sizeof(double));
+		memset(im, 0, num * sizeof(double));
+	}
+	Hlong m = (Hlong)mxGetM(A);
+	Hlong n = (Hlong)mxGetN(A);
 	HPutElem(proc_handle, 1, &m, 1, LONG_PAR);
 	HPutElem(proc_handle, 2, &n, 1, LONG_PAR);
-	HPutElem(proc_handle, 3, C, m * n, DOUBLE_PAR);
+	HPutElem(proc_handle, 3, re, (INT4_8)num, DOUBLE_PAR);
+	HPutElem(proc_handle, 4, im, (INT4_8)num, DOUBLE_PAR);
+	mxDestroyArray(A);
+	return H_MSG_TRUE;
+}
+
+// ---------------------------------------------------------------------------
+// 稀疏矩阵按 CSC 三元组交换，内存只和非零元个数 nnz 有关：
+//   Jc  N+1 个列起点 (Jc[0]=0, Jc[N]=nnz)
+//   Ir  nnz 个行号 (从 0 开始，每列内递增)
+//   Pr  nnz 个数值
+// 与 mxGetJc / mxGetIr / mxGetPr 的含义相同
+Herror HMatlab_engSetSparse(Hproc_handle proc_handle)
+{
+	Hcpar hv_M, hv_N, NAME;
+	Hcpar *Ir, *Jc, *Pr;
+	INT4_8 num_ir, num_jc, num_pr;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, LONG_PAR, &hv_M, 1);
+	HGetSPar(proc_handle, 2, LONG_PAR, &hv_N, 1);
+	HGetSPar(proc_handle, 3, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 4, &Ir, &num_ir);
+	HGetPPar(proc_handle, 5, &Jc, &num_jc);
+	HGetPPar(proc_handle, 6, &Pr, &num_pr);
+	if (hv_M.par.l < 0 || hv_N.par.l < 0)
+	{
+		return H_ERR_WIPV1;
+	}
+	size_t m = (size_t)hv_M.par.l;
+	size_t n = (size_t)hv_N.par.l;
+	if ((size_t)num_jc != n + 1)
+	{
+		return H_ERR_WIPN5;
+	}
+	if (num_ir != num_pr)
+	{
+		return H_ERR_WIPN6;
+	}
+	size_t nnz = (size_t)num_ir;
+	// 先检查整个 Jc 和各元素的类型，再按 Jc 访问 Ir：Jc[0]==0、不减、都在 [0, nnz] 内、Jc[n]==nnz
+	for (size_t j = 0; j <= n; j++)
+	{
+		if (Jc[j].type != LONG_PAR)
+		{
+			return H_ERR_WIPT5;
+		}
+		if (Jc[j].par.l < 0 || (size_t)Jc[j].par.l > nnz || (j > 0 && Jc[j].par.l < Jc[j - 1].par.l))
+		{
+			return H_ERR_WIPV5;
+		}
+	}
+	if (Jc[0].par.l != 0 || (size_t)Jc[n].par.l != nnz)
+	{
+		return H_ERR_WIPV5;
+	}
+	for (size_t k = 0; k < nnz; k++)
+	{
+		if (Ir[k].type != LONG_PAR)
+		{
+			return H_ERR_WIPT4;
+		}
+		if (Pr[k].type != LONG_PAR && Pr[k].type != DOUBLE_PAR)
+		{
+			return H_ERR_WIPT6;
+		}
+	}
+	for (size_t j = 0; j < n; j++)
+	{
+		// MATLAB 要求同一列内行号严格递增，否则后续运算结果不可预料
+		for (INT4_8 k = Jc[j].par.l; k < Jc[j + 1].par.l; k++)
+		{
+			if (Ir[k].par.l < 0 || (size_t)Ir[k].par.l >= m ||
+				(k > Jc[j].par.l && Ir[k].par.l <= Ir[k - 1].par.l))
+			{
+				return H_ERR_WIPV4;
+			}
+		}
+	}
 
+	// nzmax 至少为 1，mxCreateSparse 不接受 0
+	mxArray *A = mxCreateSparse(m, n, nnz > 0 ? nnz : 1, mxREAL);
+	if (A == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	mwIndex *ir = mxGetIr(A);
+	mwIndex *jc = mxGetJc(A);
+	double *pr = mxGetPr(A);
+	for (size_t j = 0; j <= n; j++)
+	{
+		jc[j] = (mwIndex)Jc[j].par.l;
+	}
+	for (size_t k = 0; k < nnz; k++)
+	{
+		ir[k] = (mwIndex)Ir[k].par.l;
+		pr[k] = Pr[k].type == LONG_PAR ? (double)Pr[k].par.l : Pr[k].par.d;
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	int ret = HMatlabPutVariable(session, NAME.par.s, A);
 	mxDestroyArray(A);
+	return ret == 0 ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
+}
 
+Herror HMatlab_engGetSparse(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	mxArray *A = HMatlabGetVariable(session, NAME.par.s);
+	if (A == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	// 逻辑稀疏阵的数值都是 1，复数和其他类型不支持
+	if (!mxIsSparse(A) || mxIsComplex(A) || !(mxIsDouble(A) || mxIsLogical(A)))
+	{
+		mxDestroyArray(A);
+		return H_ERR_MATLAB_ENGINE;
+	}
+	size_t n = mxGetN(A);
+	const mwIndex *jc = mxGetJc(A);
+	const mwIndex *ir = mxGetIr(A);
+	size_t nnz = (size_t)jc[n];
+	Hlong *Ir, *Jc;
+	double *Pr;
+	HAllocTmp(proc_handle, &Ir, nnz * sizeof(Hlong) + 1);
+	HAllocTmp(proc_handle, &Jc, (n + 1) * sizeof(Hlong));
+	HAllocTmp(proc_handle, &Pr, nnz * sizeof(double) + 1);
+	for (size_t j = 0; j <= n; j++)
+	{
+		Jc[j] = (Hlong)jc[j];
+	}
+	const mxLogical *logicals = mxIsLogical(A) ? mxGetLogicals(A) : NULL;
+	const double *pr = logicals == NULL ? mxGetPr(A) : NULL;
+	for (size_t k = 0; k < nnz; k++)
+	{
+		Ir[k] = (Hlong)ir[k];
+		Pr[k] = logicals != NULL ? (double)logicals[k] : pr[k];
+	}
+	Hlong m = (Hlong)mxGetM(A);
+	Hlong n_out = (Hlong)n;
+	HPutElem(proc_handle, 1, &m, 1, LONG_PAR);
+	HPutElem(proc_handle, 2, &n_out, 1, LONG_PAR);
+	HPutElem(proc_handle, 3, Ir, (INT4_8)nnz, LONG_PAR);
+	HPutElem(proc_handle, 4, Jc, (INT4_8)(n + 1), LONG_PAR);
+	HPutElem(proc_handle, 5, Pr, (INT4_8)nnz, DOUBLE_PAR);
+	mxDestroyArray(A);
 	return H_MSG_TRUE;
 }
 
+// 把 n 个互不相关的任务分给多个线程；work (元素总数) 太小时开线程不划算，直接串行。
+// 任务里抛出的 HALCON 异常转成错误码返回。
+static Herror HMatlabParallelFor(size_t n, size_t work, const std::function<void(size_t)> &fn)
+{
+	const size_t kParallelWork = (size_t)1 << 20;
+	size_t threads = std::min<size_t>(n, (std::max)(1u, std::thread::hardware_concurrency()));
+	if (work < kParallelWork)
+	{
+		threads = 1;
+	}
+	std::atomic<size_t> next(0);
+	// 线程里的异常不能逃出线程 (会 std::terminate 掉整个 HALCON 进程)，只记下第一个，
+	// 汇合后再转成错误码
+	std::mutex mutex;
+	Herror err = H_MSG_TRUE;
+	auto fail = [&](Herror code) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (err == H_MSG_TRUE)
+		{
+			err = code;
+		}
+	};
+	auto worker = [&]() {
+		for (size_t k; (k = next++) < n;)
+		{
+			try
+			{
+				fn(k);
+			}
+			catch (HException &e)
+			{
+				fail((Herror)e.ErrorCode());
+			}
+			catch (std::bad_alloc &)
+			{
+				fail(H_ERR_MEM);
+			}
+			catch (...)
+			{
+				fail(H_ERR_MATLAB_ENGINE);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	try
+	{
+		for (size_t t = 1; t < threads; t++)
+		{
+			workers.emplace_back(worker);
+		}
+	}
+	catch (...)
+	{
+		// 线程建不起来时剩下的由已有的线程和调用线程做完
+	}
+	worker();
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	return err;
+}
+
 Herror HMatlab_engGetVariable(Hproc_handle proc_handle)
 
 {
@@ -241,28 +747,94 @@ Herror HMatlab_engGetVariable(Hproc_handle proc_handle)
 	INT4_8 num;
 	HGetPPar(proc_handle, 1, &dict, &num);
 	HTuple hv_DictHandle(dict, 1);
-	HTuple hv_C, hv_GenParamValue;
-	HTuple hv_Index, hv_name, hv_MatrixID;
-	GetDictParam(hv_DictHandle, "keys", HTuple(), &hv_GenParamValue);
+	HTuple hv_GenParamValue;
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	try
 	{
-		HTuple end_val7 = (hv_GenParamValue.TupleLength()) - 1;
-		HTuple step_val7 = 1;
-		for (hv_Index = 0; hv_Index.Continue(end_val7, step_val7); hv_Index += step_val7)
+		GetDictParam(hv_DictHandle, "keys", HTuple(), &hv_GenParamValue);
+		size_t num_keys = (size_t)hv_GenParamValue.Length();
+		if (num_keys == 0)
+		{
+			return H_MSG_TRUE;
+		}
+
+		// 一次 eval 把所有变量装进临时元胞 (只是引用，不复制数据)，再一次 engGetVariable 取回。
+		// 键只能是变量名，并且每个变量都要存在，否则 hm_get__ 保持为空，和 engGetVariable 一样
+		// 报错；不会把 i、pi、close 之类的键当成表达式或函数执行。顶层的类对象 (如 cfit) 用 struct
+		// 展开，string 数组在 MATLAB 里转成 char，C 接口读不了这两种
+		std::string exists, items;
+		for (size_t k = 0; k < num_keys; k++)
+		{
+			std::string key = hv_GenParamValue[(Hlong)k].S().Text();
+			if (!HMatlabIsVarName(key))
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+			exists += (k ? "&&exist('" : "exist('") + key + "','var')==1";
+			items += (k ? "," : "") + key;
+		}
+		for (size_t k = 0; k < num_keys; k++)
+		{
+			HMatlabNoteRead(session, hv_GenParamValue[(Hlong)k].S().Text());
+		}
+		std::string cmd = "hm_get__=[];if " + exists + ",hm_get__={" + items + "};"
+			   "for hm_k__=1:numel(hm_get__),"
+			   "if isobject(hm_get__{hm_k__})&&~isstring(hm_get__{hm_k__}),"
+			   "hm_w__=warning('off','MATLAB:structOnObject');"
+			   "hm_get__{hm_k__}=struct(hm_get__{hm_k__});warning(hm_w__);end,end;"
+			   "hm_get__=convertContainedStringsToChars(hm_get__);end;";
+		if (HMatlabEvalNow(session, cmd.c_str()) != 0)
+		{
+			return H_ERR_MATLAB_ENGINE;
+		}
+		mxArray *A = HMatlabGetVariable(session, "hm_get__");
+		HMatlabClearLater(session, "hm_get__");
+		HMatlabClearLater(session, "hm_k__");
+		HMatlabClearLater(session, "hm_w__");
+		if (A == NULL || !mxIsCell(A) || mxGetNumberOfElements(A) != num_keys)
+		{
+			if (A != NULL)
+			{
+				mxDestroyArray(A);
+			}
+			return H_ERR_MATLAB_ENGINE;
+		}
+		size_t total = 0;
+		for (size_t k = 0; k < num_keys; k++)
 		{
-			hv_name = HTuple(hv_GenParamValue[hv_Index]);
-			mxArray *A = NULL;
-			if ((A = engGetVariable(ep, hv_name.S())) == NULL)
+			const mxArray *C = mxGetCell(A, k);
+			if (C == NULL)
 			{
-				return 9999;
+				mxDestroyArray(A);
+				return H_ERR_MATLAB_ENGINE;
 			}
-			// double* C =mxGetPr(A);
-			HTuple hv_C(mxGetPr(A), (int)mxGetM(A) * (int)mxGetN(A));
+			total += mxGetNumberOfElements(C);
+		}
 
-			HalconCpp::CreateMatrix((int)mxGetM(A), (int)mxGetN(A), hv_C, &hv_MatrixID);
-			SetDictTuple(hv_DictHandle, hv_name, hv_MatrixID);
-			mxDestroyArray(A);
-			hv_C.Clear();
+		// 逐个递归转换，数据量大时分到多个线程；顶层 double 仍然一律转成矩阵句柄
+		std::vector<HMatlabDictEntry> entries(num_keys);
+		std::vector<Herror> errors(num_keys, H_MSG_TRUE);
+		Herror err = HMatlabParallelFor(num_keys, total, [&](size_t k) {
+			errors[k] = HMatlabMxToDictEntry(mxGetCell(A, k), true, &entries[k]);
+		});
+		mxDestroyArray(A);
+		for (size_t k = 0; err == H_MSG_TRUE && k < num_keys; k++)
+		{
+			err = errors[k] == H_MSG_FALSE ? H_ERR_MATLAB_ENGINE : errors[k];
+		}
+		if (err != H_MSG_TRUE)
+		{
+			return err;
 		}
+		for (size_t k = 0; k < num_keys; k++)
+		{
+			HMatlabSetDictEntry(hv_DictHandle, hv_GenParamValue[(Hlong)k], entries[k]);
+		}
+	}
+	catch (HException &e)
+	{
+		return (Herror)e.ErrorCode();
 	}
 
 	return H_MSG_TRUE;
@@ -276,30 +848,1449 @@ Herror HMatlab_engPutVariable(Hproc_handle proc_handle)
 	HGetPPar(proc_handle, 1, &dict, &num);
 	HTuple hv_DictHandle(dict, 1);
 	HTuple hv_GenParamValue;
-	HTuple hv_Index, hv_MatrixIDTuple, hv_Values, hv_M, hv_N;
 
-	// int ret =engPutVariable(ep, const char* name, const mxArray * mp);
-	GetDictParam(hv_DictHandle, "keys", HTuple(), &hv_GenParamValue);
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	// 小矩阵打包成一个结构体 hm_put__ 一次上传，在 MATLAB 里用一条语句拆开；
+	// 超过 put_batch_max_member_bytes 的大矩阵单独上传，免得结构体过大
+	std::vector<std::string> small_names, large_names;
+	std::vector<mxArray *> small, large;
+	Herror err = H_MSG_TRUE;
+	try
 	{
-		HTuple end_val6 = (hv_GenParamValue.TupleLength()) - 1;
-		HTuple step_val6 = 1;
-		for (hv_Index = 0; hv_Index.Continue(end_val6, step_val6); hv_Index += step_val6)
+		GetDictParam(hv_DictHandle, "keys", HTuple(), &hv_GenParamValue);
+		for (Hlong k = 0; k < hv_GenParamValue.Length(); k++)
 		{
-			GetDictTuple(hv_DictHandle, HTuple(hv_GenParamValue[hv_Index]), &hv_MatrixIDTuple);
-			GetFullMatrix(hv_MatrixIDTuple, &hv_Values);
-			GetSizeMatrix(hv_MatrixIDTuple, &hv_M, &hv_N);
-			mxArray *xx = mxCreateDoubleMatrix(hv_M.L(), hv_N.L(), mxREAL);
-			memcpy(mxGetPr(xx), hv_Values.DArr(), hv_M.L() * hv_N.L() * sizeof(double)); // 将数组x复制到mxarray数组xx中。
-			int ret = engPutVariable(ep, hv_GenParamValue[hv_Index].S(), xx);			 // 将mxArray数组xx写入到Matlab工作空间，命名为xx。
-			mxDestroyArray(xx);
+			// 嵌套字典、字符串、混合元组、图像和区域都递归转换，一次生成整棵 mxArray
+			mxArray *xx = NULL;
+			err = HMatlabDictValueToMx(proc_handle, session, hv_DictHandle, hv_GenParamValue[k], &xx);
+			if (err != H_MSG_TRUE)
+			{
+				break;
+			}
+			size_t bytes = mxIsNumeric(xx) ? mxGetNumberOfElements(xx) * mxGetElementSize(xx) : 0;
+			bool is_large = bytes > session.put_batch_max_member_bytes;
+			(is_large ? large_names : small_names).push_back(hv_GenParamValue[k].S().Text());
+			(is_large ? large : small).push_back(xx);
+		}
+	}
+	catch (HException &e)
+	{
+		err = (Herror)e.ErrorCode();
+	}
 
+	if (err == H_MSG_TRUE && small.size() >= 2)
+	{
+		std::vector<const char *> fields(small.size());
+		std::string assign;
+		for (size_t i = 0; i < small.size(); i++)
+		{
+			fields[i] = small_names[i].c_str();
+			assign += small_names[i] + "=hm_put__." + small_names[i] + ";";
+			HMatlabNoteWrite(session, small_names[i], HMatlabMxBytes(small[i]));
+		}
+		mxArray *S = mxCreateStructMatrix(1, 1, (int)fields.size(), fields.data());
+		if (S == NULL)
+		{
+			err = H_ERR_MATLAB_ENGINE; // 键不是合法的 MATLAB 变量名
+		}
+		else
+		{
+			for (size_t i = 0; i < small.size(); i++)
+			{
+				mxSetFieldByNumber(S, 0, (int)i, small[i]);
+			}
+			int ret = HMatlabPutVariable(session, "hm_put__", S);
+			// 字段是池里的数组，先摘下来再销毁结构体
+			for (size_t i = 0; i < small.size(); i++)
+			{
+				mxSetFieldByNumber(S, 0, (int)i, NULL);
+			}
+			mxDestroyArray(S);
+			if (ret == 0)
+			{
+				// 延迟模式下赋值语句进入缓冲区，和前后的 eval 保持顺序
+				ret = HMatlabEval(session, assign.c_str());
+				HMatlabClearLater(session, "hm_put__");
+			}
 			if (ret != 0)
 			{
-				return 9999;
+				err = H_ERR_MATLAB_ENGINE;
 			}
 		}
-		return H_MSG_TRUE;
 	}
+	else
+	{
+		large_names.insert(large_names.end(), small_names.begin(), small_names.end());
+		large.insert(large.end(), small.begin(), small.end());
+		small.clear();
+	}
+	for (size_t i = 0; err == H_MSG_TRUE && i < large.size(); i++)
+	{
+		int ret = HMatlabPutVariable(session, large_names[i].c_str(), large[i]); // 将mxArray数组xx写入到Matlab工作空间，命名为xx。
+		if (ret != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+	}
+
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		HMatlabReleaseMx(session, small[i]);
+	}
+	for (size_t i = 0; i < large.size(); i++)
+	{
+		HMatlabReleaseMx(session, large[i]);
+	}
+	return err;
+}
+
+// ---------------------------------------------------------------------------
+// HALCON 矩阵 (按行存放) 和 HMatlabMatrix (按列存放) 的相互转换
+static void HMatlabReadMatrix(const HTuple &hv_MatrixID, HMatlabMatrix *m)
+{
+	HTuple hv_Values, hv_M, hv_N;
+	GetFullMatrix(hv_MatrixID, &hv_Values);
+	GetSizeMatrix(hv_MatrixID, &hv_M, &hv_N);
+	m->rows = (size_t)hv_M.L();
+	m->cols = (size_t)hv_N.L();
+	m->data.resize(m->rows * m->cols);
+	const double *v = hv_Values.DArr();
+	for (size_t r = 0; r < m->rows; r++)
+	{
+		for (size_t c = 0; c < m->cols; c++)
+		{
+			m->data[c * m->rows + r] = v[r * m->cols + c];
+		}
+	}
+}
+
+static void HMatlabWriteMatrix(const HMatlabMatrix &m, HTuple *hv_MatrixID)
+{
+	std::vector<double> v(m.rows * m.cols);
+	for (size_t r = 0; r < m.rows; r++)
+	{
+		for (size_t c = 0; c < m.cols; c++)
+		{
+			v[r * m.cols + c] = m.data[c * m.rows + r];
+		}
+	}
+	CreateMatrix((Hlong)m.rows, (Hlong)m.cols, HTuple(v.data(), (Hlong)v.size()), hv_MatrixID);
+}
+
+// 只接受实数 double 满矩阵
+static bool HMatlabFromMxArray(const mxArray *A, HMatlabMatrix *m)
+{
+	if (A == NULL || !mxIsDouble(A) || mxIsComplex(A) || mxIsSparse(A) ||
+		mxGetNumberOfDimensions(A) > 2)
+	{
+		return false;
+	}
+	m->rows = mxGetM(A);
+	m->cols = mxGetN(A);
+	m->data.assign(mxGetPr(A), mxGetPr(A) + m->rows * m->cols);
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// [R1,R2,...] = FuncName(A1,A2,...)，参数和结果都通过 DictHandle 里的矩阵传递
+// 参数和结果在 MATLAB 中使用临时变量 hm_a<i>__ / hm_r<i>__，不会覆盖用户变量
+static Herror HMatlabFevalEngine(HMatlabSession &session, const char *func, const std::vector<HMatlabMatrix> &inputs,
+								 size_t nargout, std::vector<HMatlabMatrix> *outputs)
+{
+	char name[32];
+	std::string args, results;
+	std::vector<std::string> temps;
+	Herror err = H_MSG_TRUE;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		snprintf(name, sizeof(name), "hm_a%u__", (unsigned)(i + 1));
+		mxArray *A = session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, inputs[i].rows, inputs[i].cols);
+		if (A == NULL)
+		{
+			err = H_ERR_MEM;
+			continue;
+		}
+		memcpy(mxGetPr(A), inputs[i].data.data(), inputs[i].data.size() * sizeof(double));
+		int ret = HMatlabPutVariable(session, name, A);
+		session.pool.Release(A);
+		if (ret != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+		args += (i ? "," : "") + std::string(name);
+		temps.push_back(name);
+	}
+	for (size_t i = 0; i < nargout; i++)
+	{
+		snprintf(name, sizeof(name), "hm_r%u__", (unsigned)(i + 1));
+		results += (i ? "," : "") + std::string(name);
+		temps.push_back(name);
+	}
+	std::string cmd = nargout ? "[" + results + "]=" : std::string();
+	cmd += std::string(func) + "(" + args + ");";
+	if (err == H_MSG_TRUE && HMatlabEvalNow(session, cmd.c_str()) != 0)
+	{
+		err = H_ERR_MATLAB_ENGINE;
+	}
+	outputs->resize(nargout);
+	for (size_t i = 0; err == H_MSG_TRUE && i < nargout; i++)
+	{
+		// MATLAB 报错时结果变量不会被赋值，engGetVariable 返回 NULL
+		snprintf(name, sizeof(name), "hm_r%u__", (unsigned)(i + 1));
+		mxArray *A = HMatlabGetVariable(session, name);
+		if (!HMatlabFromMxArray(A, &(*outputs)[i]))
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+		if (A != NULL)
+		{
+			mxDestroyArray(A);
+		}
+	}
+	// 清理临时变量不需要等结果，随下一次 eval 一起执行
+	for (size_t i = 0; i < temps.size(); i++)
+	{
+		HMatlabClearLater(session, temps[i].c_str());
+	}
+	return err;
+}
+
+// 同一函数的 N 次调用合并成一次 eval：第 i 个参数是 1xN 元胞 hm_b<i>__，第 k 个结果
+// 是 1xN 元胞 hm_c<k>__。只省掉每次调用的引擎往返，MATLAB 里仍然逐个调用函数，
+// 每次调用单独 try/catch，出错的序号记在 hm_bad__ 里，只有这些调用返回错误；
+// 成功的调用不会因为同批的其他调用出错而再执行一遍。参数没能上传时还没有调用执行过，
+// 改为逐个调用
+static void HMatlabFevalCalls(HMatlabSession &session, const char *func, size_t nargout,
+							  std::vector<HMatlabBatchCall *> &calls)
+{
+	size_t n = calls.size();
+	size_t nargin = calls[0]->inputs->size();
+	HMatlabNoteConsume(session);
+	if (n == 1 || nargin == 0)
+	{
+		for (size_t j = 0; j < n; j++)
+		{
+			calls[j]->result = HMatlabFevalEngine(session, func, *calls[j]->inputs, nargout, calls[j]->outputs);
+		}
+		return;
+	}
+	bool uploaded = true;
+	char name[32];
+	std::string args, results;
+	std::vector<std::string> temps;
+	for (size_t i = 0; uploaded && i < nargin; i++)
+	{
+		snprintf(name, sizeof(name), "hm_b%u__", (unsigned)(i + 1));
+		mxArray *C = mxCreateCellMatrix(1, n);
+		for (size_t j = 0; C != NULL && j < n; j++)
+		{
+			const HMatlabMatrix &m = (*calls[j]->inputs)[i];
+			mxArray *A = mxCreateDoubleMatrix(m.rows, m.cols, mxREAL);
+			if (A == NULL)
+			{
+				mxDestroyArray(C);
+				C = NULL;
+				break;
+			}
+			memcpy(mxGetPr(A), m.data.data(), m.data.size() * sizeof(double));
+			mxSetCell(C, j, A);
+		}
+		uploaded = C != NULL && HMatlabPutVariable(session, name, C) == 0;
+		if (C != NULL)
+		{
+			mxDestroyArray(C);
+		}
+		args += (i ? "," : "") + std::string(name) + "{hm_j__}";
+		temps.push_back(name);
+	}
+	char count[32];
+	snprintf(count, sizeof(count), "%u", (unsigned)n);
+	std::string init = "hm_bad__=false(1," + std::string(count) + ");";
+	for (size_t k = 0; k < nargout; k++)
+	{
+		snprintf(name, sizeof(name), "hm_c%u__", (unsigned)(k + 1));
+		results += (k ? "," : "") + std::string(name) + "{hm_j__}";
+		init += std::string(name) + "=cell(1," + std::string(count) + ");";
+		temps.push_back(name);
+	}
+	temps.push_back("hm_bad__");
+	temps.push_back("hm_j__");
+
+	bool ran = false;
+	if (uploaded)
+	{
+		std::string cmd = init + "for hm_j__=1:" + std::string(count) + ",try,";
+		cmd += nargout ? "[" + results + "]=" : std::string();
+		cmd += std::string(func) + "(" + args + ");catch,hm_bad__(hm_j__)=true;end,end;";
+		ran = HMatlabEvalNow(session, cmd.c_str()) == 0;
+	}
+	// 逐个调用已经 try/catch，整条语句失败说明引擎本身出了问题，不知道哪些调用执行过，
+	// 全部报错而不是重新执行
+	Herror batch_err = ran ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
+	mxArray *bad = ran ? HMatlabGetVariable(session, "hm_bad__") : NULL;
+	if (ran && (bad == NULL || !mxIsLogical(bad) || mxGetNumberOfElements(bad) != n))
+	{
+		batch_err = H_ERR_MATLAB_ENGINE;
+	}
+	std::vector<mxArray *> cells(nargout, (mxArray *)NULL);
+	for (size_t k = 0; batch_err == H_MSG_TRUE && k < nargout; k++)
+	{
+		snprintf(name, sizeof(name), "hm_c%u__", (unsigned)(k + 1));
+		cells[k] = HMatlabGetVariable(session, name);
+		if (cells[k] == NULL || !mxIsCell(cells[k]) || mxGetNumberOfElements(cells[k]) != n)
+		{
+			batch_err = H_ERR_MATLAB_ENGINE;
+		}
+	}
+	for (size_t j = 0; j < n; j++)
+	{
+		if (!uploaded)
+		{
+			calls[j]->result = HMatlabFevalEngine(session, func, *calls[j]->inputs, nargout, calls[j]->outputs);
+			continue;
+		}
+		if (batch_err != H_MSG_TRUE || mxGetLogicals(bad)[j])
+		{
+			calls[j]->result = H_ERR_MATLAB_ENGINE;
+			continue;
+		}
+		bool converted = true;
+		calls[j]->outputs->resize(nargout);
+		for (size_t k = 0; converted && k < nargout; k++)
+		{
+			converted = HMatlabFromMxArray(mxGetCell(cells[k], j), &(*calls[j]->outputs)[k]);
+		}
+		calls[j]->result = converted ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
+	}
+	for (size_t k = 0; k < nargout; k++)
+	{
+		if (cells[k] != NULL)
+		{
+			mxDestroyArray(cells[k]);
+		}
+	}
+	if (bad != NULL)
+	{
+		mxDestroyArray(bad);
+	}
+	for (size_t i = 0; i < temps.size(); i++)
+	{
+		HMatlabClearLater(session, temps[i].c_str());
+	}
+}
+
+// 一次 Matlab_engFeval 的引擎部分。带截止时间的调用在引擎工作线程或调度线程上执行，调用方
+// 超时返回后任务可能还在运行，所以参数、结果和状态都放在任务里，由 shared_ptr 共同持有
+struct HMatlabFevalTask
+{
+	HMatlabFevalTask()
+		: session(NULL), nargout(0), pooled(false), batch(false), priority(kHMatlabPriorityNormal),
+		  use_cache(false), deadline_us(0), started(false), abandoned(false), done(false),
+		  result(H_ERR_MATLAB_ENGINE) {}
+
+	HMatlabSession *session;
+	std::string func;
+	std::vector<HMatlabMatrix> inputs, outputs;
+	size_t nargout;
+	bool pooled, batch;
+	std::vector<std::string> shared_vars;
+	HMatlabPriority priority;
+	std::string ns; // 调用线程的工作区命名空间
+	bool use_cache;
+	std::string cache_key;
+	uint64_t deadline_us; // 0 表示没有截止时间
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool started, abandoned, done;
+	Herror result;
+};
+
+// 拿到引擎后、调用函数前检查：截止时间已过或调用方已经放弃时不再执行
+static bool HMatlabFevalBegin(HMatlabFevalTask &task)
+{
+	std::lock_guard<std::mutex> lock(task.mutex);
+	if (task.abandoned || (task.deadline_us != 0 && HMatlabClockUs() >= task.deadline_us))
+	{
+		return false;
+	}
+	task.started = true;
+	return true;
+}
+
+// 任务执行完毕。超时的任务跑完后照样进缓存；只有调用方还在等的 (按时完成的) 结果才记为该函数的
+// 上次结果，调用方已经放弃的迟到结果不给之后的调用当后备
+static void HMatlabFevalFinish(HMatlabFevalTask &task, Herror result)
+{
+	if (result == H_MSG_TRUE && task.use_cache)
+	{
+		HMatlabGetResultCache().Insert(task.cache_key, task.outputs);
+	}
+	std::lock_guard<std::mutex> lock(task.mutex);
+	if (result == H_MSG_TRUE && task.deadline_us != 0 && !task.abandoned)
+	{
+		HMatlabGetDeadlineLog().SetLast(task.func, task.nargout, task.outputs);
+	}
+	task.result = result;
+	task.done = true;
+	task.cv.notify_all();
+}
+
+static void HMatlabFevalRun(HMatlabFevalTask &task)
+{
+	HMatlabPriorityGuard priority(task.priority);
+	HMatlabNamespaceGuard ns(task.ns);
+	HMatlabSession &session = *task.session;
+	// 执行一批调用 (不合并时只有自己一个)。同一批的调用方会话、函数、参数个数都相同
+	HMatlabFevalBatcher::Runner run = [&](std::vector<HMatlabBatchCall *> &calls) {
+		std::function<Herror(HMatlabSession &)> body = [&](HMatlabSession &engine) {
+			if (HMatlabFevalBegin(task))
+			{
+				HMatlabFevalCalls(engine, task.func.c_str(), task.nargout, calls);
+			}
+			return (Herror)H_MSG_TRUE;
+		};
+		if (task.pooled)
+		{
+			Herror err = HMatlabSchedule(session, task.shared_vars, body);
+			for (size_t j = 0; err != H_MSG_TRUE && j < calls.size(); j++)
+			{
+				calls[j]->result = err;
+			}
+		}
+		else
+		{
+			// 只在真正调用引擎时独占，缓存命中和矩阵转换不占用引擎
+			HMatlabCallScope scope(session);
+			body(session);
+		}
+	};
+	HMatlabBatchCall call;
+	call.inputs = &task.inputs;
+	call.outputs = &task.outputs;
+	call.result = H_ERR_MATLAB_ENGINE;
+	try
+	{
+		if (task.batch)
+		{
+			// 只有引擎、函数、参数和结果个数、调度方式、优先级、命名空间都相同的调用才能合并。
+			// 不走调度器的调用在自己会话的引擎上执行，按会话区分：各线程绑定各自的引擎时
+			// (engine_affinity) 它们本来就不在同一个引擎上，不会合并。走调度器且不依赖工作区
+			// 变量的调用可以在任一引擎上执行，不区分提交的会话
+			char sig[160];
+			snprintf(sig, sizeof(sig), "%p|%u|%u|%d|%d|",
+					 task.pooled && task.shared_vars.empty() ? NULL : (void *)&session, (unsigned)task.inputs.size(),
+					 (unsigned)task.nargout, (int)task.pooled, (int)task.priority);
+			std::string batch_key = sig + task.ns + "|" + task.func;
+			for (size_t i = 0; i < task.shared_vars.size(); i++)
+			{
+				batch_key += "|" + task.shared_vars[i];
+			}
+			HMatlabGetFevalBatcher().Submit(batch_key, &call, run);
+		}
+		else
+		{
+			std::vector<HMatlabBatchCall *> single(1, &call);
+			run(single);
+		}
+	}
+	catch (...)
+	{
+		call.result = H_ERR_MATLAB_ENGINE;
+	}
+	HMatlabFevalFinish(task, (Herror)call.result);
+}
+
+// 带截止时间的调用不等完成就返回给调用方：不走调度器的放进会话引擎工作线程的队列，
+// 走调度器的异步交给调度器，都在已有的线程上执行，不为每次调用新建线程
+static void HMatlabFevalPost(const std::shared_ptr<HMatlabFevalTask> &task)
+{
+	if (!task->pooled)
+	{
+		task->session->worker.Post([task]() { HMatlabFevalRun(*task); });
+		return;
+	}
+	std::shared_ptr<HMatlabBatchCall> call(new HMatlabBatchCall());
+	call->inputs = &task->inputs;
+	call->outputs = &task->outputs;
+	call->result = H_ERR_MATLAB_ENGINE;
+	HMatlabSchedulePost(
+		*task->session, task->shared_vars,
+		[task, call](HMatlabSession &engine) {
+			if (HMatlabFevalBegin(*task))
+			{
+				std::vector<HMatlabBatchCall *> calls(1, call.get());
+				HMatlabFevalCalls(engine, task->func.c_str(), task->nargout, calls);
+			}
+			return (Herror)H_MSG_TRUE;
+		},
+		[task, call](Herror err) { HMatlabFevalFinish(*task, err != H_MSG_TRUE ? err : (Herror)call->result); });
+}
+
+Herror HMatlab_engFeval(Hproc_handle proc_handle)
+{
+	Hcpar FuncName;
+	Hcpar *ArgNames, *ResultNames, *dict, *GenParamName, *GenParamValue;
+	INT4_8 num_args, num_results, num, num_gen_name, num_gen_value;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &FuncName, 1);
+	HGetPPar(proc_handle, 2, &ArgNames, &num_args);
+	HGetPPar(proc_handle, 3, &ResultNames, &num_results);
+	HGetPPar(proc_handle, 4, &dict, &num);
+	HGetPPar(proc_handle, 5, &GenParamName, &num_gen_name);
+	HGetPPar(proc_handle, 6, &GenParamValue, &num_gen_value);
+	if (num_gen_name != num_gen_value)
+	{
+		return H_ERR_WIPN6;
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	HMatlabResultCache &cache = HMatlabGetResultCache();
+	bool use_cache = cache.Enabled();
+	// 'pool'：交给调度器在池里任一空闲引擎上执行，'shared_vars' 列出函数依赖的工作区变量
+	bool pooled = false;
+	std::vector<std::string> shared_vars;
+	HMatlabPriority priority = HMatlabThreadPriority();
+	bool batch = true;
+	// 'deadline'：HMatlabClockUs 的绝对时间。'fallback'：超时时字典里的结果保持调用前的值
+	// ('keep'，调用方事先放好后备结果) 或者换成该函数上次按时完成的结果 ('last')
+	uint64_t deadline_us = 0;
+	bool fallback_last = false;
+	for (INT4_8 i = 0; i < num_gen_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT5;
+		}
+		if (strcmp(GenParamName[i].par.s, "cache") == 0)
+		{
+			use_cache = HMatlabParBool(GenParamValue[i]);
+		}
+		else if (strcmp(GenParamName[i].par.s, "schedule") == 0)
+		{
+			std::string mode = HMatlabParString(GenParamValue[i]);
+			if (mode != "session" && mode != "pool")
+			{
+				return H_ERR_WIPV6;
+			}
+			pooled = mode == "pool";
+		}
+		else if (strcmp(GenParamName[i].par.s, "shared_vars") == 0)
+		{
+			if (GenParamValue[i].type != STRING_PAR)
+			{
+				return H_ERR_WIPT6;
+			}
+			shared_vars.push_back(GenParamValue[i].par.s);
+		}
+		else if (strcmp(GenParamName[i].par.s, "batch") == 0)
+		{
+			batch = HMatlabParBool(GenParamValue[i]);
+		}
+		else if (strcmp(GenParamName[i].par.s, "deadline") == 0)
+		{
+			double deadline = HMatlabParDouble(GenParamValue[i]);
+			if (deadline < 0)
+			{
+				return H_ERR_WIPV6;
+			}
+			deadline_us = (uint64_t)deadline;
+		}
+		else if (strcmp(GenParamName[i].par.s, "fallback") == 0)
+		{
+			std::string mode = HMatlabParString(GenParamValue[i]);
+			if (mode != "keep" && mode != "last")
+			{
+				return H_ERR_WIPV6;
+			}
+			fallback_last = mode == "last";
+		}
+		else if (strcmp(GenParamName[i].par.s, "priority") == 0)
+		{
+			if (!HMatlabParsePriority(HMatlabParString(GenParamValue[i]), &priority))
+			{
+				return H_ERR_WIPV6;
+			}
+		}
+		else
+		{
+			return H_ERR_WIPV5;
+		}
+	}
+
+	HMatlabPriorityGuard priority_guard(priority);
+	const char *status = "computed";
+	try
+	{
+		HTuple hv_DictHandle(dict, 1);
+		std::vector<HMatlabMatrix> inputs(num_args), outputs;
+		for (INT4_8 i = 0; i < num_args; i++)
+		{
+			if (ArgNames[i].type != STRING_PAR)
+			{
+				return H_ERR_WIPT2;
+			}
+			HTuple hv_MatrixID;
+			GetDictTuple(hv_DictHandle, ArgNames[i].par.s, &hv_MatrixID);
+			HMatlabReadMatrix(hv_MatrixID, &inputs[i]);
+		}
+		for (INT4_8 i = 0; i < num_results; i++)
+		{
+			if (ResultNames[i].type != STRING_PAR)
+			{
+				return H_ERR_WIPT3;
+			}
+		}
+
+		std::string key;
+		bool hit = false;
+		if (use_cache)
+		{
+			key = cache.MakeKey(FuncName.par.s, (size_t)num_results, inputs);
+			hit = cache.Lookup(key, &outputs);
+		}
+		bool write = true;
+		if (hit)
+		{
+			status = "cached";
+		}
+		else
+		{
+			std::shared_ptr<HMatlabFevalTask> task(new HMatlabFevalTask());
+			task->session = &session;
+			task->func = FuncName.par.s;
+			task->inputs.swap(inputs);
+			task->nargout = (size_t)num_results;
+			task->pooled = pooled;
+			// 合并要等一个窗口，带截止时间的调用不参与
+			task->batch = batch && num_args > 0 && deadline_us == 0;
+			task->shared_vars = shared_vars;
+			task->priority = priority;
+			task->ns = HMatlabThreadNamespace();
+			task->use_cache = use_cache;
+			task->cache_key = key;
+			task->deadline_us = deadline_us;
+			if (deadline_us == 0)
+			{
+				HMatlabFevalRun(*task);
+			}
+			else if (HMatlabClockUs() < deadline_us)
+			{
+				// 引擎调用没法中途打断，调用方只等到截止时间，任务在后台继续
+				HMatlabFevalPost(task);
+				std::unique_lock<std::mutex> lock(task->mutex);
+				std::chrono::steady_clock::time_point until{std::chrono::microseconds(deadline_us)};
+				if (!task->cv.wait_until(lock, until, [&task]() { return task->done; }))
+				{
+					task->abandoned = true;
+				}
+			}
+			bool started, done;
+			{
+				std::lock_guard<std::mutex> lock(task->mutex);
+				task->abandoned = task->abandoned || !task->done;
+				started = task->started;
+				done = task->done;
+			}
+			if (deadline_us != 0 && (!started || !done))
+			{
+				// 没能按时开始的拒绝执行，开始了但超时的返回后备结果
+				HMatlabGetDeadlineLog().RecordMiss(task->func, !started);
+				status = started ? "fallback" : "rejected";
+				write = fallback_last && HMatlabGetDeadlineLog().GetLast(task->func, task->nargout, &outputs);
+			}
+			else if (task->result != H_MSG_TRUE)
+			{
+				return task->result;
+			}
+			else
+			{
+				outputs.swap(task->outputs);
+			}
+		}
+		for (INT4_8 i = 0; write && i < num_results; i++)
+		{
+			HTuple hv_MatrixID;
+			HMatlabWriteMatrix(outputs[i], &hv_MatrixID);
+			SetDictTuple(hv_DictHandle, ResultNames[i].par.s, hv_MatrixID);
+		}
+	}
+	catch (HException &e)
+	{
+		return (Herror)e.ErrorCode();
+	}
+	return HPutElem(proc_handle, 1, &status, 1, STRING_PAR) == H_MSG_OK ? H_MSG_TRUE : H_ERR_MEM;
+}
+
+// ---------------------------------------------------------------------------
+// 执行延迟模式下缓冲的语句，返回上次调用以来出错的语句和错误信息。序号是从上次
+// Matlab_engFlush 以来第几次 Matlab_engEvalString (从 1 开始)，包括达到 eval_batch_max 时
+// 自动执行的批；0 表示扩展自己生成的语句
+Herror HMatlab_engFlush(Hproc_handle proc_handle)
+{
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (HMatlabFlush(session) != 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	std::vector<size_t> errors;
+	std::vector<std::string> messages;
+	errors.swap(session.error_index);
+	messages.swap(session.error_message);
+	session.eval_seq = 0;
+	size_t num = errors.size();
+	Hlong *index;
+	char **message;
+	HCkP(HAllocTmp(proc_handle, &index, num * sizeof(Hlong) + 1));
+	HCkP(HAllocTmp(proc_handle, &message, num * sizeof(char *) + 1));
+	for (size_t i = 0; i < num; i++)
+	{
+		index[i] = (Hlong)errors[i];
+		message[i] = (char *)messages[i].c_str();
+	}
+	HCkP(HPutElem(proc_handle, 1, index, (INT4_8)num, LONG_PAR));
+	HCkP(HPutElem(proc_handle, 2, message, (INT4_8)num, STRING_PAR));
+	return H_MSG_TRUE;
+}
+
+// 调用线程所在工作区 (设置了命名空间时是命名空间) 的变量、类型和字节数
+Herror HMatlab_engWorkspaceInfo(Hproc_handle proc_handle)
+{
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	std::vector<std::string> names, classes;
+	std::vector<uint64_t> bytes;
+	if (!HMatlabWorkspaceInfo(session, &names, &classes, &bytes))
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	size_t num = names.size();
+	char **name;
+	char **cls;
+	Hlong *size;
+	HCkP(HAllocTmp(proc_handle, &name, num * sizeof(char *) + 1));
+	HCkP(HAllocTmp(proc_handle, &cls, num * sizeof(char *) + 1));
+	HCkP(HAllocTmp(proc_handle, &size, num * sizeof(Hlong) + 1));
+	for (size_t i = 0; i < num; i++)
+	{
+		name[i] = (char *)names[i].c_str();
+		cls[i] = (char *)classes[i].c_str();
+		size[i] = (Hlong)bytes[i];
+	}
+	HCkP(HPutElem(proc_handle, 1, name, (INT4_8)num, STRING_PAR));
+	HCkP(HPutElem(proc_handle, 2, cls, (INT4_8)num, STRING_PAR));
+	HCkP(HPutElem(proc_handle, 3, size, (INT4_8)num, LONG_PAR));
+	return H_MSG_TRUE;
+}
+
+// ---------------------------------------------------------------------------
+// 扩展包的全局参数，类似 set_system / get_system
+Herror HMatlab_engSetParam(Hproc_handle proc_handle)
+{
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_name, num_value;
+	HGetPPar(proc_handle, 1, &GenParamName, &num_name);
+	HGetPPar(proc_handle, 2, &GenParamValue, &num_value);
+	if (num_name != num_value)
+	{
+		return H_ERR_WIPN2;
+	}
+	HMatlabResultCache &cache = HMatlabGetResultCache();
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabEngineScope scope(session.worker);
+	for (INT4_8 i = 0; i < num_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT1;
+		}
+		std::string name = GenParamName[i].par.s;
+		const Hcpar &value = GenParamValue[i];
+		if (name == "cache_enable")
+		{
+			cache.SetEnabled(HMatlabParBool(value));
+		}
+		else if (name == "cache_max_bytes")
+		{
+			double bytes = HMatlabParDouble(value);
+			if (bytes < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			cache.SetMaxBytes((size_t)bytes);
+		}
+		else if (name == "cache_dir")
+		{
+			cache.SetDir(HMatlabParString(value));
+		}
+		else if (name == "cache_clear")
+		{
+			cache.Clear();
+		}
+		else if (name == "pool_max_bytes")
+		{
+			double bytes = HMatlabParDouble(value);
+			if (bytes < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.pool.SetMaxBytes((size_t)bytes);
+		}
+		else if (name == "pool_clear")
+		{
+			session.pool.Clear();
+		}
+		else if (name == "eval_mode")
+		{
+			std::string mode = HMatlabParString(value);
+			if (mode != "immediate" && mode != "deferred")
+			{
+				return H_ERR_WIPV2;
+			}
+			if (mode == "immediate")
+			{
+				HMatlabFlush(session);
+			}
+			session.deferred = mode == "deferred";
+		}
+		else if (name == "eval_batch_max")
+		{
+			double max = HMatlabParDouble(value);
+			if (max < 1)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.batch_max = (size_t)max;
+		}
+		else if (name == "put_batch_max_member_bytes")
+		{
+			double bytes = HMatlabParDouble(value);
+			if (bytes < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.put_batch_max_member_bytes = (size_t)bytes;
+		}
+		else if (name == "put_integer_class")
+		{
+			std::string cls = HMatlabParString(value);
+			if (cls != "double" && cls != "int64")
+			{
+				return H_ERR_WIPV2;
+			}
+			session.put_int64 = cls == "int64";
+		}
+		else if (name == "chunk_bytes")
+		{
+			double bytes = HMatlabParDouble(value);
+			if (bytes < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.chunk_bytes = (size_t)bytes;
+		}
+		else if (name == "promote_threshold")
+		{
+			double threshold = HMatlabParDouble(value);
+			if (threshold < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.promoter.SetThreshold((size_t)threshold);
+		}
+		else if (name == "worker_stats_reset")
+		{
+			session.worker.ResetStats();
+		}
+		else if (name == "workspace_auto_clear")
+		{
+			session.auto_clear = HMatlabParBool(value);
+		}
+		else if (name == "workspace_transient")
+		{
+			// 'U,I,CC'，'' 表示没有临时变量
+			if (!HMatlabParseNameList(HMatlabParString(value), &session.transient))
+			{
+				return H_ERR_WIPV2;
+			}
+		}
+		else if (name == "workspace_soft_limit" || name == "workspace_hard_limit")
+		{
+			// 超过硬限制时在某次算子成功返回后重开引擎，用户变量全部丢失 (见 Halcon_MatlabWorkspace.h)
+			double bytes = HMatlabParDouble(value);
+			if (bytes < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			(name == "workspace_soft_limit" ? session.soft_limit : session.hard_limit) = (uint64_t)bytes;
+		}
+		else if (name == "workspace_check_interval")
+		{
+			double interval = HMatlabParDouble(value);
+			if (interval < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.check_interval = (size_t)interval;
+		}
+		else if (name == "workspace_cleanup")
+		{
+			if (session.ep != NULL && !HMatlabWorkspaceCleanup(session))
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+		}
+		else if (name == "workspace_recycle")
+		{
+			if (session.ep != NULL && !HMatlabRecycleEngine(session))
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+		}
+		else if (name == "workspace_stats_reset")
+		{
+			session.auto_cleared = 0;
+			session.soft_cleanups = 0;
+			session.recycles = 0;
+			session.recycle_failures = 0;
+		}
+		else if (name == "scheduler_stats_reset")
+		{
+			HMatlabSchedulerResetStats();
+		}
+		else if (name == "feval_batch_window_us")
+		{
+			double window = HMatlabParDouble(value);
+			if (window < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabGetFevalBatcher().SetWindowUs((uint64_t)window);
+		}
+		else if (name == "feval_batch_max")
+		{
+			double max = HMatlabParDouble(value);
+			if (max < 1)
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabGetFevalBatcher().SetMaxCalls((size_t)max);
+		}
+		else if (name == "matlab_threads")
+		{
+			// 0 恢复 MATLAB 的自动设置
+			double threads = HMatlabParDouble(value);
+			if (threads < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			session.comp_threads.store((int)threads);
+			if (session.ep != NULL && !HMatlabApplyCpuSettings(session))
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+		}
+		else if (name == "engine_cores")
+		{
+			// 核列表如 '4-7'；空字符串解除绑定 (恢复到所有核)
+			std::string spec = HMatlabParString(value);
+			uint64_t mask = 0;
+			uint64_t all = HMatlabLogicalCores() >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << HMatlabLogicalCores()) - 1;
+			if (!HMatlabParseCoreSet(spec, &mask) || (mask != 0 && (mask & all) == 0))
+			{
+				return H_ERR_WIPV2;
+			}
+			session.core_mask.store(mask & all);
+			if (session.ep != NULL &&
+				!HMatlabSetProcessCores(HMatlabEnginePid(session), mask != 0 ? mask & all : all))
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+		}
+		else if (name == "deadline_stats_reset")
+		{
+			HMatlabGetDeadlineLog().Reset();
+		}
+		else if (name == "feval_batch_stats_reset")
+		{
+			HMatlabGetFevalBatcher().ResetStats();
+		}
+		else if (name == "job_priority")
+		{
+			HMatlabPriority priority;
+			if (!HMatlabParsePriority(HMatlabParString(value), &priority))
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabSetThreadPriority(priority);
+		}
+		else if (name == "workspace_namespace")
+		{
+			// 只影响调用线程，'' 回到基本工作区
+			std::string id = HMatlabParString(value);
+			if (!HMatlabIsNamespaceId(id))
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabSetThreadNamespace(id);
+		}
+		else if (name == "workspace_namespace_clear")
+		{
+			std::string id = HMatlabParString(value);
+			if (id.empty() || !HMatlabIsNamespaceId(id))
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabNamespaceGuard base("");
+			if (session.ep != NULL && HMatlabEval(session, ("clear " + HMatlabNamespaceVar(id) + ";").c_str()) != 0)
+			{
+				return H_ERR_MATLAB_ENGINE;
+			}
+		}
+		else if (name == "scheduler_reserved_high")
+		{
+			double engines = HMatlabParDouble(value);
+			if (engines < 0)
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabSchedulerSetReserved((size_t)engines);
+		}
+		else if (name == "engine_affinity")
+		{
+			std::string mode = HMatlabParString(value);
+			if (mode != "none" && mode != "thread")
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabSetThreadAffinity(mode == "thread");
+		}
+		else if (name == "engine_pool_size")
+		{
+			double size = HMatlabParDouble(value);
+			if (size < 1)
+			{
+				return H_ERR_WIPV2;
+			}
+			HMatlabSetEnginePoolSize((size_t)size);
+		}
+		else
+		{
+			return H_ERR_WIPV1;
+		}
+	}
+	return H_MSG_TRUE;
+}
+
+// 按优先级分开的统计项，名字为 <prefix><high|normal|background>
+static bool PriorityStat(const std::string &name, const char *prefix, HMatlabPriority *priority)
+{
+	size_t len = strlen(prefix);
+	return name.compare(0, len, prefix) == 0 && HMatlabParsePriority(name.substr(len), priority);
+}
+
+Herror HMatlab_engGetParam(Hproc_handle proc_handle)
+{
+	Hcpar *GenParamName;
+	INT4_8 num_name;
+	HGetPPar(proc_handle, 1, &GenParamName, &num_name);
+	Hcpar *values;
+	HAllocTmp(proc_handle, &values, (size_t)num_name * sizeof(Hcpar) + 1);
+	HMatlabResultCache &cache = HMatlabGetResultCache();
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabEngineScope scope(session.worker);
+	std::vector<std::string> strings((size_t)num_name);
+	HMatlabPriority priority;
+	for (INT4_8 i = 0; i < num_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT1;
+		}
+		std::string name = GenParamName[i].par.s;
+		values[i].type = LONG_PAR;
+		if (name == "cache_enable")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = cache.Enabled() ? "true" : "false";
+		}
+		else if (name == "cache_max_bytes")
+		{
+			values[i].par.l = (INT4_8)cache.MaxBytes();
+		}
+		else if (name == "cache_dir")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = cache.Dir();
+		}
+		else if (name == "cache_hits")
+		{
+			values[i].par.l = (INT4_8)cache.Hits();
+		}
+		else if (name == "cache_misses")
+		{
+			values[i].par.l = (INT4_8)cache.Misses();
+		}
+		else if (name == "cache_disk_hits")
+		{
+			values[i].par.l = (INT4_8)cache.DiskHits();
+		}
+		else if (name == "cache_bytes")
+		{
+			values[i].par.l = (INT4_8)cache.Bytes();
+		}
+		else if (name == "cache_entries")
+		{
+			values[i].par.l = (INT4_8)cache.Entries();
+		}
+		else if (name == "pool_max_bytes")
+		{
+			values[i].par.l = (INT4_8)session.pool.MaxBytes();
+		}
+		else if (name == "pool_hits")
+		{
+			values[i].par.l = (INT4_8)session.pool.Hits();
+		}
+		else if (name == "pool_misses")
+		{
+			values[i].par.l = (INT4_8)session.pool.Misses();
+		}
+		else if (name == "pool_idle_bytes")
+		{
+			values[i].par.l = (INT4_8)session.pool.IdleBytes();
+		}
+		else if (name == "pool_in_use_bytes")
+		{
+			values[i].par.l = (INT4_8)session.pool.InUseBytes();
+		}
+		else if (name == "pool_high_water_bytes")
+		{
+			values[i].par.l = (INT4_8)session.pool.HighWaterBytes();
+		}
+		else if (name == "eval_mode")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = session.deferred ? "deferred" : "immediate";
+		}
+		else if (name == "eval_batch_max")
+		{
+			values[i].par.l = (INT4_8)session.batch_max;
+		}
+		else if (name == "eval_pending")
+		{
+			values[i].par.l = (INT4_8)session.pending.size();
+		}
+		else if (name == "batch_flushes")
+		{
+			values[i].par.l = (INT4_8)session.flushes;
+		}
+		else if (name == "batch_statements")
+		{
+			values[i].par.l = (INT4_8)session.batched;
+		}
+		else if (name == "put_batch_max_member_bytes")
+		{
+			values[i].par.l = (INT4_8)session.put_batch_max_member_bytes;
+		}
+		else if (name == "put_integer_class")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = session.put_int64 ? "int64" : "double";
+		}
+		else if (name == "chunk_bytes")
+		{
+			values[i].par.l = (INT4_8)session.chunk_bytes;
+		}
+		else if (name == "promote_threshold")
+		{
+			values[i].par.l = (INT4_8)session.promoter.Threshold();
+		}
+		else if (name == "promote_hits")
+		{
+			values[i].par.l = (INT4_8)session.promoter.Hits();
+		}
+		else if (name == "promote_count")
+		{
+			values[i].par.l = (INT4_8)session.promoter.Promoted();
+		}
+		else if (name == "promote_candidates")
+		{
+			values[i].par.l = (INT4_8)session.promoter.Candidates();
+		}
+		else if (name == "worker_jobs")
+		{
+			values[i].par.l = (INT4_8)session.worker.Jobs();
+		}
+		else if (name == "worker_queue_wait_us")
+		{
+			values[i].par.l = (INT4_8)session.worker.QueueWaitUs();
+		}
+		else if (name == "worker_queue_wait_max_us")
+		{
+			values[i].par.l = (INT4_8)session.worker.QueueWaitMaxUs();
+		}
+		else if (name == "worker_queue_depth_max")
+		{
+			values[i].par.l = (INT4_8)session.worker.QueueDepthMax();
+		}
+		else if (name == "scope_count")
+		{
+			values[i].par.l = (INT4_8)session.worker.Scopes();
+		}
+		else if (name == "scope_contended")
+		{
+			values[i].par.l = (INT4_8)session.worker.ScopesContended();
+		}
+		else if (name == "scope_wait_us")
+		{
+			values[i].par.l = (INT4_8)session.worker.ScopeWaitUs();
+		}
+		else if (name == "scope_wait_max_us")
+		{
+			values[i].par.l = (INT4_8)session.worker.ScopeWaitMaxUs();
+		}
+		else if (name == "engine_affinity")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = HMatlabThreadAffinity() ? "thread" : "none";
+		}
+		else if (name == "engine_pool_size")
+		{
+			values[i].par.l = (INT4_8)HMatlabEnginePoolSize();
+		}
+		else if (name == "engine_count")
+		{
+			values[i].par.l = (INT4_8)HMatlabEngineCount();
+		}
+		else if (name == "engine_index")
+		{
+			values[i].par.l = (INT4_8)HMatlabSessionIndex(session);
+		}
+		else if (name == "engine_shared_binds")
+		{
+			values[i].par.l = (INT4_8)HMatlabSharedBinds();
+		}
+		else if (name == "scheduler_jobs")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerJobs();
+		}
+		else if (name == "scheduler_steals")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerSteals();
+		}
+		else if (name == "scheduler_replications")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerReplications();
+		}
+		else if (name == "scheduler_wait_us")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerWaitUs();
+		}
+		else if (name == "scheduler_wait_max_us")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerWaitMaxUs();
+		}
+		else if (name == "scheduler_reserved_high")
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerReserved();
+		}
+		else if (name == "matlab_threads")
+		{
+			values[i].par.l = (INT4_8)session.comp_threads.load();
+		}
+		else if (name == "engine_cores")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = HMatlabFormatCoreSet(session.core_mask.load());
+		}
+		else if (name == "engine_pid")
+		{
+			values[i].par.l = session.ep != NULL ? (INT4_8)HMatlabEnginePid(session) : 0;
+		}
+		else if (name == "engine_profile")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = session.profile;
+		}
+		else if (name == "engine_startcmd")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = session.startcmd;
+		}
+		else if (name == "engine_startup_us")
+		{
+			values[i].par.l = (INT4_8)session.startup_us;
+		}
+		else if (name == "workspace_auto_clear")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = session.auto_clear ? "true" : "false";
+		}
+		else if (name == "workspace_transient")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = HMatlabFormatNameList(session.transient);
+		}
+		else if (name == "workspace_soft_limit")
+		{
+			values[i].par.l = (INT4_8)session.soft_limit;
+		}
+		else if (name == "workspace_hard_limit")
+		{
+			values[i].par.l = (INT4_8)session.hard_limit;
+		}
+		else if (name == "workspace_check_interval")
+		{
+			values[i].par.l = (INT4_8)session.check_interval;
+		}
+		else if (name == "workspace_tracked" || name == "workspace_tracked_bytes")
+		{
+			// 通过扩展写入、还没被清掉的变量，所有命名空间合计
+			uint64_t count = 0, bytes = 0;
+			for (std::map<std::pair<std::string, std::string>, HMatlabTrackedVar>::const_iterator it =
+					 session.tracked.begin();
+				 it != session.tracked.end(); ++it)
+			{
+				count += it->second.written != 0 ? 1 : 0;
+				bytes += it->second.bytes;
+			}
+			values[i].par.l = (INT4_8)(name == "workspace_tracked" ? count : bytes);
+		}
+		else if (name == "workspace_auto_cleared")
+		{
+			values[i].par.l = (INT4_8)session.auto_cleared;
+		}
+		else if (name == "workspace_soft_cleanups")
+		{
+			values[i].par.l = (INT4_8)session.soft_cleanups;
+		}
+		else if (name == "workspace_recycles")
+		{
+			values[i].par.l = (INT4_8)session.recycles;
+		}
+		else if (name == "workspace_recycle_failures")
+		{
+			values[i].par.l = (INT4_8)session.recycle_failures;
+		}
+		else if (name == "workspace_last_rss_bytes")
+		{
+			values[i].par.l = (INT4_8)session.last_resident;
+		}
+		else if (name == "engine_rss_bytes" || name == "engine_peak_rss_bytes")
+		{
+			uint64_t resident = 0, peak = 0;
+			if (session.ep != NULL)
+			{
+				HMatlabProcessMemory(HMatlabEnginePid(session), &resident, &peak);
+			}
+			values[i].par.l = (INT4_8)(name == "engine_rss_bytes" ? resident : peak);
+		}
+		else if (name == "cpu_logical_cores")
+		{
+			values[i].par.l = (INT4_8)HMatlabLogicalCores();
+		}
+		else if (name == "cpu_physical_cores")
+		{
+			values[i].par.l = (INT4_8)HMatlabPhysicalCores();
+		}
+		else if (name == "recommended_thread_num")
+		{
+			values[i].par.l = (INT4_8)HMatlabRecommendedThreadNum();
+		}
+		else if (name == "clock_us")
+		{
+			values[i].par.l = (INT4_8)HMatlabClockUs();
+		}
+		else if (name == "deadline_misses")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetDeadlineLog().Misses("");
+		}
+		else if (name == "deadline_rejected")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetDeadlineLog().Rejected("");
+		}
+		else if (name.compare(0, 16, "deadline_misses_") == 0)
+		{
+			values[i].par.l = (INT4_8)HMatlabGetDeadlineLog().Misses(name.substr(16));
+		}
+		else if (name.compare(0, 18, "deadline_rejected_") == 0)
+		{
+			values[i].par.l = (INT4_8)HMatlabGetDeadlineLog().Rejected(name.substr(18));
+		}
+		else if (name == "feval_batch_window_us")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetFevalBatcher().WindowUs();
+		}
+		else if (name == "feval_batch_max")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetFevalBatcher().MaxCalls();
+		}
+		else if (name == "feval_batches")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetFevalBatcher().Batches();
+		}
+		else if (name == "feval_batched_calls")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetFevalBatcher().BatchedCalls();
+		}
+		else if (name == "feval_batch_largest")
+		{
+			values[i].par.l = (INT4_8)HMatlabGetFevalBatcher().LargestBatch();
+		}
+		else if (name == "job_priority")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = HMatlabPriorityName(HMatlabThreadPriority());
+		}
+		else if (name == "workspace_namespace")
+		{
+			values[i].type = STRING_PAR;
+			strings[i] = HMatlabThreadNamespace();
+		}
+		else if (PriorityStat(name, "scope_count_", &priority))
+		{
+			values[i].par.l = (INT4_8)session.worker.Scopes(priority);
+		}
+		else if (PriorityStat(name, "scope_wait_us_", &priority))
+		{
+			values[i].par.l = (INT4_8)session.worker.ScopeWaitUs(priority);
+		}
+		else if (PriorityStat(name, "scope_wait_max_us_", &priority))
+		{
+			values[i].par.l = (INT4_8)session.worker.ScopeWaitMaxUs(priority);
+		}
+		else if (PriorityStat(name, "scheduler_jobs_", &priority))
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerJobs(priority);
+		}
+		else if (PriorityStat(name, "scheduler_wait_us_", &priority))
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerWaitUs(priority);
+		}
+		else if (PriorityStat(name, "scheduler_wait_max_us_", &priority))
+		{
+			values[i].par.l = (INT4_8)HMatlabSchedulerWaitMaxUs(priority);
+		}
+		else
+		{
+			return H_ERR_WIPV1;
+		}
+	}
+	for (INT4_8 i = 0; i < num_name; i++)
+	{
+		if (values[i].type == STRING_PAR)
+		{
+			values[i].par.s = (char *)strings[i].c_str();
+		}
+	}
+	// HPutPPar 会复制字符串，strings 在此之后释放即可
+	return HPutPPar(proc_handle, 1, values, num_name) == H_MSG_OK ? H_MSG_TRUE : H_ERR_MEM;
 }
 
 // int main()
@@ -0,0 +1,137 @@
+#include "Halcon_MatlabBatch.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+HMatlabFevalBatcher::HMatlabFevalBatcher()
+	: window_us_(0), max_calls_(64), batches_(0), batched_calls_(0), largest_(0)
+{
+}
+
+HMatlabFevalBatcher &HMatlabGetFevalBatcher()
+{
+	static HMatlabFevalBatcher batcher;
+	return batcher;
+}
+
+uint64_t HMatlabFevalBatcher::WindowUs()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return window_us_;
+}
+
+void HMatlabFevalBatcher::SetWindowUs(uint64_t window_us)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	window_us_ = window_us;
+}
+
+size_t HMatlabFevalBatcher::MaxCalls()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return max_calls_;
+}
+
+void HMatlabFevalBatcher::SetMaxCalls(size_t max_calls)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_calls_ = (std::max)(max_calls, (size_t)1);
+}
+
+void HMatlabFevalBatcher::Submit(const std::string &key, HMatlabBatchCall *call, const Runner &run)
+{
+	call->done = false;
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (window_us_ == 0 || max_calls_ <= 1)
+	{
+		lock.unlock();
+		std::vector<HMatlabBatchCall *> single(1, call);
+		run(single);
+		call->done = true;
+		return;
+	}
+
+	std::map<std::string, Batch *>::iterator it = open_.find(key);
+	if (it != open_.end())
+	{
+		// 加入已经打开的批，等 leader 执行完
+		Batch *batch = it->second;
+		batch->calls.push_back(call);
+		if (batch->calls.size() >= max_calls_)
+		{
+			open_.erase(it);
+			batch->full.notify_one();
+		}
+		done_.wait(lock, [call]() { return call->done; });
+		return;
+	}
+
+	// 自己当 leader：打开一个批，等窗口结束或者攒满
+	Batch batch;
+	batch.calls.push_back(call);
+	open_[key] = &batch;
+	std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::microseconds(window_us_);
+	batch.full.wait_until(lock, deadline, [&]() { return batch.calls.size() >= max_calls_; });
+	it = open_.find(key);
+	if (it != open_.end() && it->second == &batch)
+	{
+		open_.erase(it);
+	}
+	if (batch.calls.size() > 1)
+	{
+		batches_++;
+		batched_calls_ += batch.calls.size();
+		largest_ = (std::max)(largest_, (uint64_t)batch.calls.size());
+	}
+	lock.unlock();
+
+	// run 抛出异常时也要放行其他调用方，它们保留调用前设置的 result
+	std::exception_ptr error;
+	try
+	{
+		run(batch.calls);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	lock.lock();
+	for (size_t i = 0; i < batch.calls.size(); i++)
+	{
+		batch.calls[i]->done = true;
+	}
+	done_.notify_all();
+	if (error)
+	{
+		lock.unlock();
+		std::rethrow_exception(error);
+	}
+}
+
+uint64_t HMatlabFevalBatcher::Batches()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return batches_;
+}
+
+uint64_t HMatlabFevalBatcher::BatchedCalls()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return batched_calls_;
+}
+
+uint64_t HMatlabFevalBatcher::LargestBatch()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return largest_;
+}
+
+void HMatlabFevalBatcher::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	batches_ = 0;
+	batched_calls_ = 0;
+	largest_ = 0;
+}
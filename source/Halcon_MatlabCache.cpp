@@ -0,0 +1,325 @@
+﻿#include "Halcon_MatlabCache.h"
+#include "mat.h"
+#include <cstdio>
+#include <cstring>
+
+// 按 8 字节一组混合的非加密哈希，只用于缓存键，不用于安全场景
+uint64_t HMatlabHashBytes(const void *data, size_t size, uint64_t seed)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t w;
+		memcpy(&w, bytes + i, 8);
+		h ^= w * 0x9E3779B97F4A7C15ULL;
+		h = ((h << 31) | (h >> 33)) * 0xBF58476D1CE4E5B9ULL;
+	}
+	for (; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= 0x100000001B3ULL;
+	}
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return h;
+}
+
+static size_t MatricesBytes(const std::vector<HMatlabMatrix> &m)
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < m.size(); i++)
+	{
+		bytes += sizeof(HMatlabMatrix) + m[i].data.size() * sizeof(double);
+	}
+	return bytes;
+}
+
+HMatlabResultCache::HMatlabResultCache()
+	: enabled_(false), max_bytes_((size_t)64 << 20), bytes_(0),
+	  hits_(0), misses_(0), disk_hits_(0)
+{
+}
+
+std::string HMatlabResultCache::MakeKey(const char *func, size_t nargout,
+										const std::vector<HMatlabMatrix> &inputs) const
+{
+	// 两个不同种子的 64 位哈希拼成 128 位，碰撞概率可以忽略
+	uint64_t h1 = HMatlabHashBytes(func, strlen(func), 0x243F6A8885A308D3ULL);
+	uint64_t h2 = HMatlabHashBytes(func, strlen(func), 0x13198A2E03707344ULL);
+	size_t head[3] = {nargout, inputs.size(), 0};
+	h1 = HMatlabHashBytes(head, sizeof(head), h1);
+	h2 = HMatlabHashBytes(head, sizeof(head), h2);
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		size_t dims[2] = {inputs[i].rows, inputs[i].cols};
+		h1 = HMatlabHashBytes(dims, sizeof(dims), h1);
+		h2 = HMatlabHashBytes(dims, sizeof(dims), h2);
+		h1 = HMatlabHashBytes(inputs[i].data.data(), inputs[i].data.size() * sizeof(double), h1);
+		h2 = HMatlabHashBytes(inputs[i].data.data(), inputs[i].data.size() * sizeof(double), h2);
+	}
+
+	// 键同时作为磁盘文件名，函数名里只保留合法字符
+	std::string key;
+	for (const char *c = func; *c; c++)
+	{
+		bool ok = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') ||
+				  (*c >= '0' && *c <= '9') || *c == '_';
+		key += ok ? *c : '_';
+	}
+	char hex[40];
+	snprintf(hex, sizeof(hex), "_%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+	return key + hex;
+}
+
+bool HMatlabResultCache::Lookup(const std::string &key, std::vector<HMatlabMatrix> *outputs)
+{
+	std::string dir;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = index_.find(key);
+		if (it != index_.end())
+		{
+			lru_.splice(lru_.begin(), lru_, it->second);
+			*outputs = it->second->outputs;
+			hits_++;
+			return true;
+		}
+		dir = dir_;
+	}
+	// 内存未命中再查磁盘，读文件时不持锁
+	if (!dir.empty() && DiskLoad(dir, key, outputs))
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		hits_++;
+		disk_hits_++;
+		InsertLocked(key, *outputs);
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	misses_++;
+	return false;
+}
+
+void HMatlabResultCache::Insert(const std::string &key, const std::vector<HMatlabMatrix> &outputs)
+{
+	std::string dir;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		InsertLocked(key, outputs);
+		dir = dir_;
+	}
+	if (!dir.empty())
+	{
+		DiskStore(dir, key, outputs);
+	}
+}
+
+void HMatlabResultCache::InsertLocked(const std::string &key, const std::vector<HMatlabMatrix> &outputs)
+{
+	size_t bytes = MatricesBytes(outputs);
+	if (bytes > max_bytes_)
+	{
+		return; // 单条结果超过上限，不进内存层
+	}
+	auto it = index_.find(key);
+	if (it != index_.end())
+	{
+		bytes_ -= it->second->bytes;
+		lru_.erase(it->second);
+		index_.erase(it);
+	}
+	Entry entry;
+	entry.key = key;
+	entry.outputs = outputs;
+	entry.bytes = bytes;
+	lru_.push_front(entry);
+	index_[key] = lru_.begin();
+	bytes_ += bytes;
+	EvictLocked();
+}
+
+void HMatlabResultCache::EvictLocked()
+{
+	while (bytes_ > max_bytes_ && !lru_.empty())
+	{
+		bytes_ -= lru_.back().bytes;
+		index_.erase(lru_.back().key);
+		lru_.pop_back();
+	}
+}
+
+void HMatlabResultCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	lru_.clear();
+	index_.clear();
+	bytes_ = 0;
+	hits_ = 0;
+	misses_ = 0;
+	disk_hits_ = 0;
+}
+
+std::string HMatlabResultCache::DiskPath(const std::string &dir, const std::string &key)
+{
+	std::string path = dir;
+	if (path.back() != '/' && path.back() != '\\')
+	{
+		path += '/';
+	}
+	return path + key + ".mat";
+}
+
+bool HMatlabResultCache::DiskLoad(const std::string &dir, const std::string &key,
+								  std::vector<HMatlabMatrix> *outputs)
+{
+	MATFile *mfp = matOpen(DiskPath(dir, key).c_str(), "r");
+	if (mfp == NULL)
+	{
+		return false;
+	}
+	bool ok = true;
+	mxArray *count = matGetVariable(mfp, "n");
+	if (count == NULL || !mxIsDouble(count) || mxGetNumberOfElements(count) != 1)
+	{
+		ok = false;
+	}
+	outputs->clear();
+	for (size_t i = 0; ok && i < (size_t)mxGetScalar(count); i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "r%u", (unsigned)(i + 1));
+		mxArray *A = matGetVariable(mfp, name);
+		if (A == NULL || !mxIsDouble(A) || mxIsComplex(A) || mxIsSparse(A))
+		{
+			ok = false;
+		}
+		else
+		{
+			HMatlabMatrix m;
+			m.rows = mxGetM(A);
+			m.cols = mxGetN(A);
+			m.data.assign(mxGetPr(A), mxGetPr(A) + m.rows * m.cols);
+			outputs->push_back(m);
+		}
+		if (A != NULL)
+		{
+			mxDestroyArray(A);
+		}
+	}
+	if (count != NULL)
+	{
+		mxDestroyArray(count);
+	}
+	matClose(mfp);
+	return ok;
+}
+
+void HMatlabResultCache::DiskStore(const std::string &dir, const std::string &key,
+								   const std::vector<HMatlabMatrix> &outputs)
+{
+	std::string path = DiskPath(dir, key);
+	// 先写临时文件再改名，避免别的进程读到半个文件
+	std::string tmp = path + ".tmp";
+	MATFile *mfp = matOpen(tmp.c_str(), "w");
+	if (mfp == NULL)
+	{
+		return;
+	}
+	bool ok = true;
+	mxArray *count = mxCreateDoubleScalar((double)outputs.size());
+	ok = matPutVariable(mfp, "n", count) == 0;
+	mxDestroyArray(count);
+	for (size_t i = 0; ok && i < outputs.size(); i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "r%u", (unsigned)(i + 1));
+		mxArray *A = mxCreateDoubleMatrix(outputs[i].rows, outputs[i].cols, mxREAL);
+		memcpy(mxGetPr(A), outputs[i].data.data(), outputs[i].data.size() * sizeof(double));
+		ok = matPutVariable(mfp, name, A) == 0;
+		mxDestroyArray(A);
+	}
+	ok = (matClose(mfp) == 0) && ok;
+	remove(path.c_str());
+	if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+	{
+		remove(tmp.c_str());
+	}
+}
+
+bool HMatlabResultCache::Enabled()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return enabled_;
+}
+
+void HMatlabResultCache::SetEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	enabled_ = enabled;
+}
+
+size_t HMatlabResultCache::MaxBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return max_bytes_;
+}
+
+void HMatlabResultCache::SetMaxBytes(size_t max_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_bytes_ = max_bytes;
+	EvictLocked();
+}
+
+std::string HMatlabResultCache::Dir()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dir_;
+}
+
+void HMatlabResultCache::SetDir(const std::string &dir)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	dir_ = dir;
+}
+
+uint64_t HMatlabResultCache::Hits()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hits_;
+}
+
+uint64_t HMatlabResultCache::Misses()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return misses_;
+}
+
+uint64_t HMatlabResultCache::DiskHits()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return disk_hits_;
+}
+
+size_t HMatlabResultCache::Bytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return bytes_;
+}
+
+size_t HMatlabResultCache::Entries()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return lru_.size();
+}
+
+HMatlabResultCache &HMatlabGetResultCache()
+{
+	static HMatlabResultCache cache;
+	return cache;
+}
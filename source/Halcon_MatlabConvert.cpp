@@ -0,0 +1,560 @@
+#include "Halcon_MatlabConvert.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace HalconCpp;
+
+// ---------------------------------------------------------------------------
+// HALCON -> MATLAB
+
+// HALCON 矩阵按行存放，转置一次写进按列存放的 double 数组
+static Herror MatrixToMx(HMatlabSession &session, const HTuple &matrix, mxArray **out)
+{
+	HTuple hv_Values, hv_M, hv_N;
+	GetFullMatrix(matrix, &hv_Values);
+	GetSizeMatrix(matrix, &hv_M, &hv_N);
+	size_t rows = (size_t)hv_M.L();
+	size_t cols = (size_t)hv_N.L();
+	mxArray *A = session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, rows, cols);
+	if (A == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	const double *v = hv_Values.DArr();
+	double *d = mxGetDoubles(A);
+	for (size_t r = 0; r < rows; r++)
+	{
+		for (size_t c = 0; c < cols; c++)
+		{
+			d[c * rows + r] = v[r * cols + c];
+		}
+	}
+	*out = A;
+	return H_MSG_TRUE;
+}
+
+// 整数键不是合法的字段名，加前缀 x
+static std::string FieldName(const HTupleElement &key)
+{
+	if (key.Type() == STRING_PAR)
+	{
+		return key.S().Text();
+	}
+	char buf[32];
+	snprintf(buf, sizeof(buf), "x%lld", (long long)key.L());
+	return buf;
+}
+
+static Herror DictToMx(Hproc_handle proc_handle, HMatlabSession &session, const HTuple &dict, mxArray **out)
+{
+	HTuple hv_Keys;
+	GetDictParam(dict, "keys", HTuple(), &hv_Keys);
+	size_t num = (size_t)hv_Keys.Length();
+	std::vector<std::string> names(num);
+	std::vector<const char *> fields(num);
+	std::vector<mxArray *> values(num, (mxArray *)NULL);
+	Herror err = H_MSG_TRUE;
+	for (size_t k = 0; err == H_MSG_TRUE && k < num; k++)
+	{
+		names[k] = FieldName(hv_Keys[(Hlong)k]);
+		fields[k] = names[k].c_str();
+		err = HMatlabDictValueToMx(proc_handle, session, dict, hv_Keys[(Hlong)k], &values[k]);
+	}
+	mxArray *S = err == H_MSG_TRUE ? mxCreateStructMatrix(1, 1, (int)num, fields.data()) : NULL;
+	if (S == NULL)
+	{
+		for (size_t k = 0; k < num; k++)
+		{
+			HMatlabReleaseMx(session, values[k]);
+		}
+		return err != H_MSG_TRUE ? err : H_ERR_MATLAB_ENGINE;
+	}
+	for (size_t k = 0; k < num; k++)
+	{
+		mxSetFieldByNumber(S, 0, (int)k, values[k]);
+	}
+	*out = S;
+	return H_MSG_TRUE;
+}
+
+static mxArray *CellOf(std::vector<mxArray *> &items)
+{
+	mxArray *C = mxCreateCellMatrix(1, items.size());
+	for (size_t i = 0; C != NULL && i < items.size(); i++)
+	{
+		mxSetCell(C, i, items[i]);
+	}
+	return C;
+}
+
+Herror HMatlabTupleToMx(Hproc_handle proc_handle, HMatlabSession &session, const HTuple &value, mxArray **out)
+{
+	size_t num = (size_t)value.Length();
+	if (num == 0)
+	{
+		*out = mxCreateDoubleMatrix(0, 0, mxREAL);
+		return H_MSG_TRUE;
+	}
+	// 先看一遍元素类型，决定输出的形态，再一次性分配
+	bool all_long = true, all_number = true, all_string = true;
+	for (size_t i = 0; i < num; i++)
+	{
+		int type = value[(Hlong)i].Type();
+		all_long = all_long && type == LONG_PAR;
+		all_number = all_number && (type == LONG_PAR || type == DOUBLE_PAR);
+		all_string = all_string && type == STRING_PAR;
+	}
+
+	if (num == 1 && value[0].Type() == HANDLE_PAR)
+	{
+		HTuple hv_SemType;
+		TupleSemType(value, &hv_SemType);
+		std::string sem = hv_SemType.S().Text();
+		if (sem == "dict")
+		{
+			return DictToMx(proc_handle, session, value, out);
+		}
+		if (sem == "matrix")
+		{
+			return MatrixToMx(session, value, out);
+		}
+		return H_ERR_WIPT1; // 其他句柄在 MATLAB 里没有对应物
+	}
+	if (all_number)
+	{
+		// int64 在 MATLAB 里的运算规则和 double 不同 (取整、饱和、不能和 double 矩阵混算)，
+		// 只在 put_integer_class 为 'int64' 时使用
+		bool as_int64 = all_long && session.put_int64;
+		mxArray *A = session.pool.Acquire(as_int64 ? mxINT64_CLASS : mxDOUBLE_CLASS, mxREAL, 1, num);
+		if (A == NULL)
+		{
+			return H_ERR_MEM;
+		}
+		for (size_t i = 0; i < num; i++)
+		{
+			if (as_int64)
+			{
+				mxGetInt64s(A)[i] = (mxInt64)value[(Hlong)i].L();
+			}
+			else
+			{
+				mxGetDoubles(A)[i] = value[(Hlong)i].D();
+			}
+		}
+		*out = A;
+		return H_MSG_TRUE;
+	}
+	if (all_string && num == 1)
+	{
+		*out = mxCreateString(value[0].S());
+		return *out != NULL ? H_MSG_TRUE : H_ERR_MEM;
+	}
+
+	// 字符串元组和混合元组：1xn 元胞，元素逐个递归
+	std::vector<mxArray *> items(num, (mxArray *)NULL);
+	Herror err = H_MSG_TRUE;
+	for (size_t i = 0; err == H_MSG_TRUE && i < num; i++)
+	{
+		if (all_string)
+		{
+			items[i] = mxCreateString(value[(Hlong)i].S());
+			err = items[i] != NULL ? H_MSG_TRUE : H_ERR_MEM;
+		}
+		else
+		{
+			err = HMatlabTupleToMx(proc_handle, session, HTuple(value[(Hlong)i]), &items[i]);
+		}
+	}
+	mxArray *C = err == H_MSG_TRUE ? CellOf(items) : NULL;
+	if (C == NULL)
+	{
+		for (size_t i = 0; i < num; i++)
+		{
+			HMatlabReleaseMx(session, items[i]);
+		}
+		return err != H_MSG_TRUE ? err : H_ERR_MEM;
+	}
+	*out = C;
+	return H_MSG_TRUE;
+}
+
+Herror HMatlabDictValueToMx(Hproc_handle proc_handle, HMatlabSession &session,
+							const HTuple &dict, const HTuple &key, mxArray **out)
+{
+	HTuple hv_DataType;
+	GetDictParam(dict, "key_data_type", key, &hv_DataType);
+	if (strcmp(hv_DataType.S().Text(), "object") != 0)
+	{
+		HTuple hv_Value;
+		GetDictTuple(dict, key, &hv_Value);
+		return HMatlabTupleToMx(proc_handle, session, hv_Value, out);
+	}
+
+	HObject objects;
+	HTuple hv_Count;
+	GetDictObject(&objects, dict, key);
+	CountObj(objects, &hv_Count);
+	size_t num = (size_t)hv_Count.L();
+	std::vector<mxArray *> items(num, (mxArray *)NULL);
+	Herror err = H_MSG_TRUE;
+	for (size_t i = 0; err == H_MSG_TRUE && i < num; i++)
+	{
+		HObject object;
+		HTuple hv_Class;
+		SelectObj(objects, &object, (Hlong)(i + 1));
+		GetObjClass(object, &hv_Class);
+		std::string cls = hv_Class.S().Text();
+		if (cls == "image")
+		{
+			err = HMatlabImageToMx(proc_handle, session, object.Key(), &items[i]);
+		}
+		else if (cls == "region")
+		{
+			err = HMatlabRegionToMx(proc_handle, object.Key(), &items[i]);
+		}
+		else
+		{
+			err = H_ERR_WIPT1; // XLD 等请用对应的算子单独传
+		}
+	}
+	if (err == H_MSG_TRUE && num == 1)
+	{
+		*out = items[0];
+		return H_MSG_TRUE;
+	}
+	mxArray *C = err == H_MSG_TRUE ? CellOf(items) : NULL;
+	if (C == NULL)
+	{
+		for (size_t i = 0; i < num; i++)
+		{
+			HMatlabReleaseMx(session, items[i]);
+		}
+		return err != H_MSG_TRUE ? err : H_ERR_MEM;
+	}
+	*out = C;
+	return H_MSG_TRUE;
+}
+
+void HMatlabReleaseMx(HMatlabSession &session, mxArray *A)
+{
+	if (A == NULL)
+	{
+		return;
+	}
+	if (mxIsStruct(A))
+	{
+		size_t num = mxGetNumberOfElements(A);
+		int fields = mxGetNumberOfFields(A);
+		for (size_t e = 0; e < num; e++)
+		{
+			for (int f = 0; f < fields; f++)
+			{
+				mxArray *child = mxGetFieldByNumber(A, e, f);
+				mxSetFieldByNumber(A, e, f, NULL);
+				HMatlabReleaseMx(session, child);
+			}
+		}
+	}
+	else if (mxIsCell(A))
+	{
+		for (size_t i = 0; i < mxGetNumberOfElements(A); i++)
+		{
+			mxArray *child = mxGetCell(A, i);
+			mxSetCell(A, i, NULL);
+			HMatlabReleaseMx(session, child);
+		}
+	}
+	session.pool.Release(A); // 不是池里的数组直接销毁
+}
+
+// ---------------------------------------------------------------------------
+// MATLAB -> HALCON
+
+// 返回 H_MSG_FALSE 表示类型不支持 (函数句柄、类对象、稀疏阵等)，嵌套在结构体、元胞里时
+// 同样整体失败，不会悄悄丢掉字段
+static Herror MxToTuple(const mxArray *A, bool matrix_always, HTuple *tuple);
+
+static bool IsScalar(const mxArray *A)
+{
+	return mxGetNumberOfElements(A) == 1;
+}
+
+static bool IsRowVector(const mxArray *A)
+{
+	return mxGetNumberOfDimensions(A) == 2 && mxGetM(A) <= 1;
+}
+
+static double ScalarDouble(const mxArray *A)
+{
+	return mxGetScalar(A);
+}
+
+template <typename T>
+static void CopyLongs(const void *data, std::vector<Hlong> &v)
+{
+	const T *s = (const T *)data;
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		v[i] = (Hlong)s[i];
+	}
+}
+
+// 整数和逻辑数组按元素类型读成 Hlong，不经过 double，int64 的大数不丢精度
+static bool RowToLongs(const mxArray *A, std::vector<Hlong> &v)
+{
+	const void *data = mxGetData(A);
+	switch (mxGetClassID(A))
+	{
+	case mxLOGICAL_CLASS:
+	case mxUINT8_CLASS:
+		CopyLongs<uint8_t>(data, v);
+		return true;
+	case mxINT8_CLASS:
+		CopyLongs<int8_t>(data, v);
+		return true;
+	case mxUINT16_CLASS:
+		CopyLongs<uint16_t>(data, v);
+		return true;
+	case mxINT16_CLASS:
+		CopyLongs<int16_t>(data, v);
+		return true;
+	case mxUINT32_CLASS:
+		CopyLongs<uint32_t>(data, v);
+		return true;
+	case mxINT32_CLASS:
+		CopyLongs<int32_t>(data, v);
+		return true;
+	case mxUINT64_CLASS:
+		CopyLongs<uint64_t>(data, v);
+		return true;
+	case mxINT64_CLASS:
+		CopyLongs<int64_t>(data, v);
+		return true;
+	default:
+		return false;
+	}
+}
+
+// double 满阵转置成按行存放的 HALCON 矩阵
+static void MxToMatrix(const mxArray *A, HTuple *matrix)
+{
+	size_t rows = mxGetM(A);
+	size_t cols = mxGetN(A);
+	const double *d = mxGetDoubles(A);
+	std::vector<double> v(rows * cols);
+	for (size_t r = 0; r < rows; r++)
+	{
+		for (size_t c = 0; c < cols; c++)
+		{
+			v[r * cols + c] = d[c * rows + r];
+		}
+	}
+	CreateMatrix((Hlong)rows, (Hlong)cols, HTuple(v.data(), (Hlong)v.size()), matrix);
+}
+
+static Herror StructToTuple(const mxArray *A, HTuple *tuple)
+{
+	size_t num = mxGetNumberOfElements(A);
+	int fields = mxGetNumberOfFields(A);
+	HTuple handles;
+	for (size_t e = 0; e < num; e++)
+	{
+		HTuple dict;
+		CreateDict(&dict);
+		for (int f = 0; f < fields; f++)
+		{
+			const mxArray *child = mxGetFieldByNumber(A, e, f);
+			HMatlabDictEntry entry;
+			Herror err = H_MSG_TRUE;
+			if (child == NULL)
+			{
+				entry.is_object = false; // 未赋值的字段当作空元组
+			}
+			else
+			{
+				err = HMatlabMxToDictEntry(child, false, &entry);
+			}
+			if (err != H_MSG_TRUE)
+			{
+				return err;
+			}
+			HMatlabSetDictEntry(dict, mxGetFieldNameByNumber(A, f), entry);
+		}
+		handles.Append(dict);
+	}
+	*tuple = handles;
+	return H_MSG_TRUE;
+}
+
+// 元胞：元素都是标量或字符串时直接填一个预分配的 Hcpar 数组；
+// 含结构体或嵌套元胞时逐个转换再拼接
+static Herror CellToTuple(const mxArray *A, HTuple *tuple)
+{
+	size_t num = mxGetNumberOfElements(A);
+	std::vector<Hcpar> pars(num);
+	std::vector<char *> strings;
+	bool flat = true;
+	for (size_t i = 0; flat && i < num; i++)
+	{
+		const mxArray *item = mxGetCell(A, i);
+		if (item == NULL)
+		{
+			flat = false;
+		}
+		else if (mxIsChar(item) && mxGetM(item) <= 1)
+		{
+			char *s = mxArrayToString(item);
+			strings.push_back(s);
+			pars[i].type = STRING_PAR;
+			pars[i].par.s = s;
+			flat = s != NULL;
+		}
+		else if ((mxIsNumeric(item) || mxIsLogical(item)) && IsScalar(item) && !mxIsComplex(item) &&
+				 !mxIsSparse(item))
+		{
+			bool integer = mxIsLogical(item) || mxIsInt8(item) || mxIsUint8(item) || mxIsInt16(item) ||
+						   mxIsUint16(item) || mxIsInt32(item) || mxIsUint32(item) || mxIsInt64(item) ||
+						   mxIsUint64(item);
+			pars[i].type = integer ? LONG_PAR : DOUBLE_PAR;
+			if (integer)
+			{
+				pars[i].par.l = (INT4_8)ScalarDouble(item);
+			}
+			else
+			{
+				pars[i].par.d = ScalarDouble(item);
+			}
+		}
+		else
+		{
+			flat = false;
+		}
+	}
+	Herror err = H_MSG_TRUE;
+	if (flat)
+	{
+		*tuple = HTuple(pars.data(), (Hlong)num);
+	}
+	else
+	{
+		HTuple all;
+		for (size_t i = 0; err == H_MSG_TRUE && i < num; i++)
+		{
+			const mxArray *item = mxGetCell(A, i);
+			HTuple part;
+			err = item != NULL ? MxToTuple(item, false, &part) : H_MSG_TRUE;
+			all.Append(part);
+		}
+		*tuple = all;
+	}
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		mxFree(strings[i]);
+	}
+	return err;
+}
+
+static Herror MxToTuple(const mxArray *A, bool matrix_always, HTuple *tuple)
+{
+	if (mxIsSparse(A))
+	{
+		return H_MSG_FALSE; // 稀疏阵请用 Matlab_engGetSparse
+	}
+	if (mxIsStruct(A))
+	{
+		return StructToTuple(A, tuple);
+	}
+	if (mxIsCell(A))
+	{
+		return CellToTuple(A, tuple);
+	}
+	if (mxIsChar(A))
+	{
+		if (mxGetM(A) > 1)
+		{
+			return H_MSG_FALSE;
+		}
+		char *s = mxArrayToString(A);
+		if (s == NULL)
+		{
+			return H_ERR_MEM;
+		}
+		*tuple = HTuple(s);
+		mxFree(s);
+		return H_MSG_TRUE;
+	}
+	if (mxIsDouble(A) && !mxIsComplex(A))
+	{
+		size_t num = mxGetNumberOfElements(A);
+		if (num == 0)
+		{
+			*tuple = HTuple();
+		}
+		else if (!matrix_always && (IsScalar(A) || IsRowVector(A)))
+		{
+			*tuple = HTuple(mxGetDoubles(A), (Hlong)num);
+		}
+		else if (mxGetNumberOfDimensions(A) == 2)
+		{
+			MxToMatrix(A, tuple);
+		}
+		else
+		{
+			return H_MSG_FALSE;
+		}
+		return H_MSG_TRUE;
+	}
+	if ((mxIsNumeric(A) || mxIsLogical(A)) && IsRowVector(A) && !mxIsComplex(A))
+	{
+		// 逻辑和整数行向量是整数元组，single 行向量是浮点元组；
+		// 两行及以上的这些类型才是图像/区域 (见 HMatlabMxToDictEntry)
+		size_t num = mxGetNumberOfElements(A);
+		if (mxIsSingle(A))
+		{
+			std::vector<double> v(mxGetSingles(A), mxGetSingles(A) + num);
+			*tuple = HTuple(v.data(), (Hlong)num);
+			return H_MSG_TRUE;
+		}
+		std::vector<Hlong> v(num);
+		if (!RowToLongs(A, v))
+		{
+			return H_MSG_FALSE;
+		}
+		*tuple = HTuple(v.data(), (Hlong)num);
+		return H_MSG_TRUE;
+	}
+	return H_MSG_FALSE;
+}
+
+Herror HMatlabMxToDictEntry(const mxArray *A, bool matrix_always, HMatlabDictEntry *entry)
+{
+	entry->is_object = false;
+	// 只有两行及以上 (或复数) 的数组才当作图标对象，标量和行向量一律是元组，
+	// 这样 int32([1 2 3]) 之类的索引、计数结果不会变成一行高的图像
+	bool array = (!IsRowVector(A) || mxIsComplex(A)) && !mxIsSparse(A);
+	if (mxIsLogical(A) && array)
+	{
+		entry->is_object = true;
+		return HMatlabMxToRegionObject(A, &entry->object);
+	}
+	if (mxIsNumeric(A) && array && !(mxIsDouble(A) && !mxIsComplex(A)) && !mxIsInt64(A) && !mxIsUint64(A))
+	{
+		entry->is_object = true;
+		return HMatlabMxToImageObject(A, &entry->object);
+	}
+	return MxToTuple(A, matrix_always, &entry->tuple);
+}
+
+void HMatlabSetDictEntry(const HTuple &dict, const HTuple &key, const HMatlabDictEntry &entry)
+{
+	if (entry.is_object)
+	{
+		SetDictObject(entry.object, dict, key);
+	}
+	else
+	{
+		SetDictTuple(dict, key, entry.tuple);
+	}
+}
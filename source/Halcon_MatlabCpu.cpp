@@ -0,0 +1,220 @@
+#include "Halcon_MatlabCpu.h"
+#include <cstdlib>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include "windows.h"
+#include "psapi.h"
+#else
+#include <dirent.h>
+#include <fstream>
+#include <sched.h>
+#include <sys/types.h>
+#endif
+
+size_t HMatlabLogicalCores()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+size_t HMatlabPhysicalCores()
+{
+	size_t cores = 0;
+#ifdef _WIN32
+	DWORD len = 0;
+	GetLogicalProcessorInformation(NULL, &len);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!info.empty() && GetLogicalProcessorInformation(info.data(), &len))
+	{
+		for (size_t i = 0; i < info.size(); i++)
+		{
+			cores += info[i].Relationship == RelationProcessorCore;
+		}
+	}
+#else
+	// 按 (physical id, core id) 去重
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::set<std::pair<int, int> > ids;
+	std::string line;
+	int physical = 0;
+	while (std::getline(cpuinfo, line))
+	{
+		if (line.compare(0, 11, "physical id") == 0)
+		{
+			physical = atoi(line.c_str() + line.find(':') + 1);
+		}
+		else if (line.compare(0, 7, "core id") == 0)
+		{
+			ids.insert(std::make_pair(physical, atoi(line.c_str() + line.find(':') + 1)));
+		}
+	}
+	cores = ids.size();
+#endif
+	return cores > 0 ? cores : HMatlabLogicalCores();
+}
+
+bool HMatlabParseCoreSet(const std::string &spec, uint64_t *mask)
+{
+	uint64_t result = 0;
+	const char *p = spec.c_str();
+	while (*p != '\0')
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		if (end == p || first < 0 || first > 63)
+		{
+			return false;
+		}
+		long last = first;
+		p = end;
+		if (*p == '-')
+		{
+			last = strtol(p + 1, &end, 10);
+			if (end == p + 1 || last < first || last > 63)
+			{
+				return false;
+			}
+			p = end;
+		}
+		for (long c = first; c <= last; c++)
+		{
+			result |= (uint64_t)1 << c;
+		}
+		if (*p == ',')
+		{
+			p++;
+		}
+		else if (*p != '\0')
+		{
+			return false;
+		}
+	}
+	*mask = result;
+	return true;
+}
+
+std::string HMatlabFormatCoreSet(uint64_t mask)
+{
+	std::string text;
+	for (int c = 0; c < 64; c++)
+	{
+		if (!(mask >> c & 1))
+		{
+			continue;
+		}
+		int last = c;
+		while (last < 63 && (mask >> (last + 1) & 1))
+		{
+			last++;
+		}
+		text += (text.empty() ? "" : ",") + std::to_string(c);
+		if (last > c)
+		{
+			text += "-" + std::to_string(last);
+		}
+		c = last;
+	}
+	return text;
+}
+
+size_t HMatlabCoreCount(uint64_t mask)
+{
+	size_t count = 0;
+	for (; mask != 0; mask &= mask - 1)
+	{
+		count++;
+	}
+	return count;
+}
+
+bool HMatlabSetProcessCores(int64_t pid, uint64_t mask)
+{
+	if (pid <= 0 || mask == 0)
+	{
+		return false;
+	}
+#ifdef _WIN32
+	HANDLE process = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION, FALSE, (DWORD)pid);
+	if (process == NULL)
+	{
+		return false;
+	}
+	BOOL ok = SetProcessAffinityMask(process, (DWORD_PTR)mask);
+	CloseHandle(process);
+	return ok != FALSE;
+#else
+	// Linux 上亲和性按线程设置，sched_setaffinity 只影响主线程；MATLAB 启动后新建的线程
+	// 继承主线程的设置，已有的线程逐个设置
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int c = 0; c < 64; c++)
+	{
+		if (mask >> c & 1)
+		{
+			CPU_SET(c, &set);
+		}
+	}
+	bool ok = sched_setaffinity((pid_t)pid, sizeof(set), &set) == 0;
+	DIR *dir = opendir(("/proc/" + std::to_string((long long)pid) + "/task").c_str());
+	if (dir != NULL)
+	{
+		for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir))
+		{
+			pid_t tid = (pid_t)atoi(entry->d_name);
+			if (tid > 0 && tid != (pid_t)pid)
+			{
+				sched_setaffinity(tid, sizeof(set), &set);
+			}
+		}
+		closedir(dir);
+	}
+	return ok;
+#endif
+}
+
+bool HMatlabProcessMemory(int64_t pid, uint64_t *resident, uint64_t *peak)
+{
+	*resident = 0;
+	*peak = 0;
+	if (pid <= 0)
+	{
+		return false;
+	}
+#ifdef _WIN32
+	HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, (DWORD)pid);
+	if (process == NULL)
+	{
+		return false;
+	}
+	PROCESS_MEMORY_COUNTERS counters;
+	counters.cb = sizeof(counters);
+	BOOL ok = GetProcessMemoryInfo(process, &counters, sizeof(counters));
+	CloseHandle(process);
+	if (!ok)
+	{
+		return false;
+	}
+	*resident = counters.WorkingSetSize;
+	*peak = counters.PeakWorkingSetSize;
+	return true;
+#else
+	// VmRSS / VmHWM 以 kB 为单位
+	std::ifstream status(("/proc/" + std::to_string((long long)pid) + "/status").c_str());
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0)
+		{
+			*resident = (uint64_t)strtoull(line.c_str() + 6, NULL, 10) * 1024;
+		}
+		else if (line.compare(0, 6, "VmHWM:") == 0)
+		{
+			*peak = (uint64_t)strtoull(line.c_str() + 6, NULL, 10) * 1024;
+		}
+	}
+	return *resident != 0;
+#endif
+}
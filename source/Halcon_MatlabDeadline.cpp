@@ -0,0 +1,83 @@
+#include "Halcon_MatlabDeadline.h"
+#include <chrono>
+
+uint64_t HMatlabClockUs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+HMatlabDeadlineLog &HMatlabGetDeadlineLog()
+{
+	static HMatlabDeadlineLog log;
+	return log;
+}
+
+static std::string LastKey(const std::string &func, size_t nargout)
+{
+	return func + "|" + std::to_string((unsigned long long)nargout);
+}
+
+void HMatlabDeadlineLog::RecordMiss(const std::string &func, bool rejected)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Counts &counts = counts_[func];
+	counts.misses++;
+	if (rejected)
+	{
+		counts.rejected++;
+	}
+}
+
+uint64_t HMatlabDeadlineLog::Misses(const std::string &func)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t total = 0;
+	for (std::map<std::string, Counts>::iterator it = counts_.begin(); it != counts_.end(); ++it)
+	{
+		if (func.empty() || it->first == func)
+		{
+			total += it->second.misses;
+		}
+	}
+	return total;
+}
+
+uint64_t HMatlabDeadlineLog::Rejected(const std::string &func)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t total = 0;
+	for (std::map<std::string, Counts>::iterator it = counts_.begin(); it != counts_.end(); ++it)
+	{
+		if (func.empty() || it->first == func)
+		{
+			total += it->second.rejected;
+		}
+	}
+	return total;
+}
+
+void HMatlabDeadlineLog::SetLast(const std::string &func, size_t nargout, const std::vector<HMatlabMatrix> &outputs)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	last_[LastKey(func, nargout)] = outputs;
+}
+
+bool HMatlabDeadlineLog::GetLast(const std::string &func, size_t nargout, std::vector<HMatlabMatrix> *outputs)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::map<std::string, std::vector<HMatlabMatrix> >::iterator it = last_.find(LastKey(func, nargout));
+	if (it == last_.end())
+	{
+		return false;
+	}
+	*outputs = it->second;
+	return true;
+}
+
+void HMatlabDeadlineLog::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	counts_.clear();
+}
@@ -0,0 +1,1183 @@
+// HALCON 图像和 MATLAB 数组之间的传输，覆盖 HALCON 的各种像素类型。
+// HALCON 按行存放，MATLAB 按列存放，每个通道只做一次分块转置拷贝，没有中间缓冲区。
+// 复数图像用交错复数 API：HComplexPixel {re, im} 和 mxComplexSingle {real, imag}
+// 内存布局相同，按 8 字节元素整体搬运，不拆成实部、虚部再合并。
+// 单通道图像对应 height x width 数组，多通道对应 height x width x channels，
+// 多个图像对象对应 1 x k 元胞。
+// 定义域较小时可以只传外接矩形或定义域内的像素 ('roi')，取回时按记录贴回原尺寸。
+#include "Halcon_Matlab.h"
+#include "Halcon_MatlabCache.h"
+#include "Halcon_MatlabConvert.h"
+#include "Halcon_MatlabNamespace.h"
+#include "Halcon_MatlabParam.h"
+#include "Halcon_MatlabSize.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct HMatlabPixelType
+{
+	INT kind;
+	mxClassID cls;
+	mxComplexity complexity;
+	size_t bytes; // 每个像素的字节数
+	const char *name; // gen_image1 的 Type
+	const char *matlab; // MATLAB 类名
+};
+
+// direction / cyclic 图像在 MATLAB 里就是 uint8，取回时按 byte 图像处理
+static const HMatlabPixelType kPixelTypes[] = {
+	{BYTE_IMAGE, mxUINT8_CLASS, mxREAL, 1, "byte", "uint8"},
+	{INT1_IMAGE, mxINT8_CLASS, mxREAL, 1, "int1", "int8"},
+	{UINT2_IMAGE, mxUINT16_CLASS, mxREAL, 2, "uint2", "uint16"},
+	{INT2_IMAGE, mxINT16_CLASS, mxREAL, 2, "int2", "int16"},
+	{INT4_IMAGE, mxINT32_CLASS, mxREAL, 4, "int4", "int32"},
+#ifdef INT8_IMAGE
+	{INT8_IMAGE, mxINT64_CLASS, mxREAL, 8, "int8", "int64"},
+#endif
+	{FLOAT_IMAGE, mxSINGLE_CLASS, mxREAL, 4, "real", "single"},
+	{COMPLEX_IMAGE, mxSINGLE_CLASS, mxCOMPLEX, 8, "complex", "single"},
+	{DIR_IMAGE, mxUINT8_CLASS, mxREAL, 1, "direction", "uint8"},
+	{CYCLIC_IMAGE, mxUINT8_CLASS, mxREAL, 1, "cyclic", "uint8"},
+};
+
+static const HMatlabPixelType *PixelTypeByKind(INT kind)
+{
+	for (size_t i = 0; i < sizeof(kPixelTypes) / sizeof(kPixelTypes[0]); i++)
+	{
+		if (kPixelTypes[i].kind == kind)
+		{
+			return &kPixelTypes[i];
+		}
+	}
+	return NULL;
+}
+
+// HALCON 图像的宽高受 HIMGCOOR 限制：普通版 32767，HALCON XL 为 INT4
+static bool FitsImage(size_t height, size_t width)
+{
+	const size_t coord_max = sizeof(HIMGCOOR) == 2 ? SHRT_MAX : INT_MAX;
+	return height <= coord_max && width <= coord_max;
+}
+
+static const HMatlabPixelType *PixelTypeByClass(mxClassID cls, bool complex)
+{
+	for (size_t i = 0; i < sizeof(kPixelTypes) / sizeof(kPixelTypes[0]); i++)
+	{
+		if (kPixelTypes[i].cls == cls && (kPixelTypes[i].complexity == mxCOMPLEX) == complex)
+		{
+			return &kPixelTypes[i];
+		}
+	}
+	return NULL;
+}
+
+// 分块转置：src 是 rows x cols 按行存放 (行距 src_stride)，dst 按列存放 (列距 dst_stride)。
+// 32x32 的块让读写都留在缓存里。行距、列距不等于 cols、rows 时用于分片传输中的一段列。
+template <typename T>
+static void TransposeBlocked(const void *src, size_t src_stride, void *dst, size_t dst_stride,
+							 size_t rows, size_t cols)
+{
+	const size_t kBlock = 32;
+	const T *s = (const T *)src;
+	T *d = (T *)dst;
+	for (size_t r0 = 0; r0 < rows; r0 += kBlock)
+	{
+		size_t r1 = r0 + kBlock < rows ? r0 + kBlock : rows;
+		for (size_t c0 = 0; c0 < cols; c0 += kBlock)
+		{
+			size_t c1 = c0 + kBlock < cols ? c0 + kBlock : cols;
+			for (size_t r = r0; r < r1; r++)
+			{
+				for (size_t c = c0; c < c1; c++)
+				{
+					d[HMatlabColumnMajorIndex(r, c, dst_stride)] = s[HMatlabRowMajorIndex(r, c, src_stride)];
+				}
+			}
+		}
+	}
+}
+
+// 按像素字节数选择搬运单位；复数单精度是 8 字节，和 int64 一样整体搬
+static void Transpose(const void *src, size_t src_stride, void *dst, size_t dst_stride,
+					  size_t rows, size_t cols, size_t bytes)
+{
+	switch (bytes)
+	{
+	case 1:
+		TransposeBlocked<uint8_t>(src, src_stride, dst, dst_stride, rows, cols);
+		break;
+	case 2:
+		TransposeBlocked<uint16_t>(src, src_stride, dst, dst_stride, rows, cols);
+		break;
+	case 4:
+		TransposeBlocked<uint32_t>(src, src_stride, dst, dst_stride, rows, cols);
+		break;
+	case 8:
+		TransposeBlocked<uint64_t>(src, src_stride, dst, dst_stride, rows, cols);
+		break;
+	}
+}
+
+static void Transpose(const void *src, void *dst, size_t rows, size_t cols, size_t bytes)
+{
+	Transpose(src, cols, dst, rows, rows, cols, bytes);
+}
+
+// 分片传输：每片是整列的一段 [col, col + n)，MATLAB 按列存放，一片在两端都是连续的一块。
+// 每片的列数由 chunk_bytes 决定，至少一列
+static size_t ChunkColumns(const HMatlabSession &session, size_t height, size_t bytes)
+{
+	size_t column = height * bytes;
+	return session.chunk_bytes > column ? session.chunk_bytes / column : 1;
+}
+
+// ---------------------------------------------------------------------------
+// HALCON -> MATLAB
+
+// 取出图像的全部通道，各通道类型和尺寸必须一致
+static Herror ReadChannels(Hproc_handle proc_handle, Hkey key, std::vector<Himage> *images,
+						   const HMatlabPixelType **type)
+{
+	INT num_comp;
+	HCkP(HGetCompNum(proc_handle, key, &num_comp));
+	if (num_comp < 1)
+	{
+		return H_ERR_WIPV1;
+	}
+	images->resize((size_t)num_comp);
+	for (INT c = 0; c < num_comp; c++)
+	{
+		Himage &image = (*images)[(size_t)c];
+		HCkP(HGetImage(proc_handle, key, c + 1, &image));
+		const Himage &first = (*images)[0];
+		if (image.kind != first.kind || image.width != first.width || image.height != first.height)
+		{
+			return H_ERR_WIPV1;
+		}
+	}
+	*type = PixelTypeByKind((*images)[0].kind);
+	return *type != NULL ? H_MSG_TRUE : H_ERR_WIPT1;
+}
+
+static size_t ImageBytes(const std::vector<Himage> &images, const HMatlabPixelType *type)
+{
+	return (size_t)images[0].height * (size_t)images[0].width * images.size() * type->bytes;
+}
+
+static Herror ChannelsToMx(HMatlabSession &session, const std::vector<Himage> &images,
+						   const HMatlabPixelType *type, mxArray **out)
+{
+	size_t height = (size_t)images[0].height;
+	size_t width = (size_t)images[0].width;
+	mxArray *A;
+	if (images.size() == 1)
+	{
+		A = session.pool.Acquire(type->cls, type->complexity, height, width);
+	}
+	else
+	{
+		mwSize dims[3] = {height, width, (mwSize)images.size()};
+		A = mxCreateUninitNumericArray(3, dims, type->cls, type->complexity);
+	}
+	if (A == NULL)
+	{
+		return H_ERR_MEM;
+	}
+	char *data = type->complexity == mxCOMPLEX ? (char *)mxGetComplexSingles(A) : (char *)mxGetData(A);
+	size_t plane = height * width * type->bytes;
+	for (size_t c = 0; c < images.size(); c++)
+	{
+		Transpose(images[c].pixel.p, data + c * plane, height, width, type->bytes);
+	}
+	*out = A;
+	return H_MSG_TRUE;
+}
+
+Herror HMatlabImageToMx(Hproc_handle proc_handle, HMatlabSession &session, Hkey key, mxArray **out)
+{
+	std::vector<Himage> images;
+	const HMatlabPixelType *type;
+	HCkP(ReadChannels(proc_handle, key, &images, &type));
+	return ChannelsToMx(session, images, type, out);
+}
+
+// 分片上传到 MATLAB 里的 target (变量名或 NAME{k})：先在 MATLAB 端按最终大小分配，
+// 再逐片 put 到 hm_chunk__ 并赋值进去。除 HALCON 图像本身外，任何时刻只有一片的
+// mxArray 和 MATLAB 端的一份拷贝，峰值额外内存由 chunk_bytes 决定。
+// 命名空间里的变量直接写结构体的字段，每片原地赋值，不经过 hm_ns_exec__
+static Herror PutChunked(HMatlabSession &session, const std::vector<Himage> &images,
+						 const HMatlabPixelType *type, const std::string &name)
+{
+	std::string target = HMatlabNamespaceRef(name);
+	HMatlabNamespaceGuard base("");
+	size_t height = (size_t)images[0].height;
+	size_t width = (size_t)images[0].width;
+	std::string dims = std::to_string((unsigned long long)height) + "," +
+					   std::to_string((unsigned long long)width) + "," +
+					   std::to_string((unsigned long long)images.size());
+	std::string alloc = "zeros(" + dims + ",'" + type->matlab + "')";
+	if (type->complexity == mxCOMPLEX)
+	{
+		alloc = "complex(" + alloc + ")";
+	}
+	if (HMatlabEval(session, (target + "=" + alloc + ";").c_str()) != 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	size_t step = ChunkColumns(session, height, type->bytes);
+	Herror err = H_MSG_TRUE;
+	for (size_t c = 0; err == H_MSG_TRUE && c < images.size(); c++)
+	{
+		const char *pixels = (const char *)images[c].pixel.p;
+		for (size_t col = 0; err == H_MSG_TRUE && col < width; col += step)
+		{
+			size_t n = step < width - col ? step : width - col;
+			// 大小相同的片反复从池里取，只有最后一片可能不同
+			mxArray *slab = session.pool.Acquire(type->cls, type->complexity, height, n);
+			if (slab == NULL)
+			{
+				err = H_ERR_MEM;
+				break;
+			}
+			char *data = type->complexity == mxCOMPLEX ? (char *)mxGetComplexSingles(slab) : (char *)mxGetData(slab);
+			Transpose(pixels + col * type->bytes, width, data, height, height, n, type->bytes);
+			int ret = HMatlabPutVariable(session, "hm_chunk__", slab);
+			session.pool.Release(slab);
+			std::string cmd = target + "(:," + std::to_string((unsigned long long)col + 1) + ":" +
+							  std::to_string((unsigned long long)(col + n)) + "," +
+							  std::to_string((unsigned long long)c + 1) + ")=hm_chunk__;";
+			if (ret != 0 || HMatlabEval(session, cmd.c_str()) != 0)
+			{
+				err = H_ERR_MATLAB_ENGINE;
+			}
+		}
+	}
+	HMatlabClearLater(session, "hm_chunk__");
+	return err;
+}
+
+// 定义域和外接矩形。行程假定在图像范围内 (HALCON 图像的定义域总是如此)
+static Herror ReadRoi(Hproc_handle proc_handle, Hkey key, const Himage &image, const std::string &mode,
+					  HMatlabImageRoi *roi)
+{
+	Hrlregion *domain;
+	HCkP(HGetFDRL(proc_handle, key, &domain));
+	roi->mode = mode;
+	roi->width = (size_t)image.width;
+	roi->height = (size_t)image.height;
+	roi->row0 = roi->col0 = roi->rows = roi->cols = roi->count = 0;
+	roi->runs.resize((size_t)domain->num * 3);
+	size_t row1 = 0, col1 = 0;
+	for (size_t i = 0; i < (size_t)domain->num; i++)
+	{
+		const Hrun &run = domain->rl[i];
+		roi->runs[i * 3] = run.l;
+		roi->runs[i * 3 + 1] = run.cb;
+		roi->runs[i * 3 + 2] = run.ce;
+		roi->count += (size_t)(run.ce - run.cb + 1);
+		if (i == 0 || (size_t)run.l < roi->row0)
+		{
+			roi->row0 = (size_t)run.l;
+		}
+		if (i == 0 || (size_t)run.cb < roi->col0)
+		{
+			roi->col0 = (size_t)run.cb;
+		}
+		row1 = std::max(row1, (size_t)run.l + 1);
+		col1 = std::max(col1, (size_t)run.ce + 1);
+	}
+	if (domain->num > 0)
+	{
+		roi->rows = row1 - roi->row0;
+		roi->cols = col1 - roi->col0;
+	}
+	return H_MSG_TRUE;
+}
+
+// 定义域在外接矩形里的掩码，按列存放 rows x cols，和 MATLAB logical 数组布局相同
+static void BuildMask(const HMatlabImageRoi &roi, mxLogical *mask)
+{
+	memset(mask, 0, roi.rows * roi.cols * sizeof(mxLogical));
+	for (size_t i = 0; i + 2 < roi.runs.size(); i += 3)
+	{
+		size_t r = (size_t)roi.runs[i] - roi.row0;
+		for (size_t c = (size_t)roi.runs[i + 1]; c <= (size_t)roi.runs[i + 2]; c++)
+		{
+			mask[(c - roi.col0) * roi.rows + r] = 1;
+		}
+	}
+}
+
+// 'bbox'：外接矩形内的像素，rows x cols [x channels]，矩形内定义域外的像素值不确定。
+// 'domain'：结构体 {pixels, mask, offset}，pixels 是 count x channels，顺序和
+// MATLAB 里 img(mask) 相同 (按列)，offset 是外接矩形左上角 [row col] (从 0 开始)
+static Herror RoiToMx(const std::vector<Himage> &images, const HMatlabPixelType *type,
+					  const HMatlabImageRoi &roi, mxArray **out)
+{
+	size_t bytes = type->bytes;
+	size_t width = roi.width;
+	if (roi.mode == "bbox")
+	{
+		mwSize dims[3] = {roi.rows, roi.cols, (mwSize)images.size()};
+		mxArray *A = mxCreateUninitNumericArray(images.size() > 1 ? 3 : 2, dims, type->cls, type->complexity);
+		if (A == NULL)
+		{
+			return H_ERR_MEM;
+		}
+		char *data = type->complexity == mxCOMPLEX ? (char *)mxGetComplexSingles(A) : (char *)mxGetData(A);
+		size_t plane = roi.rows * roi.cols * bytes;
+		for (size_t c = 0; c < images.size(); c++)
+		{
+			const char *pixels = (const char *)images[c].pixel.p + (roi.row0 * width + roi.col0) * bytes;
+			Transpose(pixels, width, data + c * plane, roi.rows, roi.rows, roi.cols, bytes);
+		}
+		*out = A;
+		return H_MSG_TRUE;
+	}
+
+	static const char *kFields[3] = {"pixels", "mask", "offset"};
+	mxArray *S = mxCreateStructMatrix(1, 1, 3, kFields);
+	mxArray *P = mxCreateUninitNumericMatrix(roi.count, images.size(), type->cls, type->complexity);
+	mxArray *M = mxCreateLogicalMatrix(roi.rows, roi.cols);
+	mxArray *O = mxCreateDoubleMatrix(1, 2, mxREAL);
+	if (S == NULL || P == NULL || M == NULL || O == NULL)
+	{
+		mxArray *all[4] = {S, P, M, O};
+		for (int i = 0; i < 4; i++)
+		{
+			if (all[i] != NULL)
+			{
+				mxDestroyArray(all[i]);
+			}
+		}
+		return H_ERR_MEM;
+	}
+	mxLogical *mask = mxGetLogicals(M);
+	BuildMask(roi, mask);
+	mxGetDoubles(O)[0] = (double)roi.row0;
+	mxGetDoubles(O)[1] = (double)roi.col0;
+	char *data = type->complexity == mxCOMPLEX ? (char *)mxGetComplexSingles(P) : (char *)mxGetData(P);
+	for (size_t c = 0; c < images.size(); c++)
+	{
+		const char *pixels = (const char *)images[c].pixel.p;
+		char *dst = data + c * roi.count * bytes;
+		for (size_t col = 0; col < roi.cols; col++)
+		{
+			for (size_t row = 0; row < roi.rows; row++)
+			{
+				if (mask[col * roi.rows + row])
+				{
+					memcpy(dst, pixels + ((roi.row0 + row) * width + roi.col0 + col) * bytes, bytes);
+					dst += bytes;
+				}
+			}
+		}
+	}
+	mxSetFieldByNumber(S, 0, 0, P);
+	mxSetFieldByNumber(S, 0, 1, M);
+	mxSetFieldByNumber(S, 0, 2, O);
+	*out = S;
+	return H_MSG_TRUE;
+}
+
+Herror HMatlab_engPutImage(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_gen_name, num_gen_value;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 2, &GenParamName, &num_gen_name);
+	HGetPPar(proc_handle, 3, &GenParamValue, &num_gen_value);
+	if (num_gen_name != num_gen_value)
+	{
+		return H_ERR_WIPN3;
+	}
+	// 'roi'：'full' 传整幅图，'bbox' 只传定义域外接矩形，'domain' 只传定义域内的像素和掩码
+	std::string roi_mode = "full";
+	for (INT4_8 i = 0; i < num_gen_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT2;
+		}
+		if (strcmp(GenParamName[i].par.s, "roi") != 0)
+		{
+			return H_ERR_WIPV2;
+		}
+		roi_mode = HMatlabParString(GenParamValue[i]);
+		if (roi_mode != "full" && roi_mode != "bbox" && roi_mode != "domain")
+		{
+			return H_ERR_WIPV3;
+		}
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	INT4_8 num_obj;
+	HCkP(HGetObjNum(proc_handle, 1, &num_obj));
+	std::vector<mxArray *> values((size_t)num_obj, (mxArray *)NULL);
+	std::vector<HMatlabImageRoi> rois(roi_mode == "full" ? 0 : (size_t)num_obj);
+	// 超过 chunk_bytes 的图像先空着，整体 put 之后再分片写进去
+	std::vector<std::vector<Himage> > chunked((size_t)num_obj);
+	std::vector<const HMatlabPixelType *> chunked_type((size_t)num_obj, (const HMatlabPixelType *)NULL);
+	Herror err = H_MSG_TRUE;
+	for (INT4_8 k = 0; err == H_MSG_TRUE && k < num_obj; k++)
+	{
+		Hkey key;
+		std::vector<Himage> images;
+		const HMatlabPixelType *type;
+		err = HGetObj(proc_handle, 1, k + 1, &key);
+		if (err == H_MSG_OK)
+		{
+			err = ReadChannels(proc_handle, key, &images, &type);
+		}
+		if (err != H_MSG_TRUE)
+		{
+			break;
+		}
+		if (!rois.empty())
+		{
+			err = ReadRoi(proc_handle, key, images[0], roi_mode, &rois[(size_t)k]);
+			if (err == H_MSG_TRUE)
+			{
+				err = RoiToMx(images, type, rois[(size_t)k], &values[(size_t)k]);
+			}
+		}
+		else if (session.chunk_bytes > 0 && ImageBytes(images, type) > session.chunk_bytes)
+		{
+			chunked[(size_t)k].swap(images);
+			chunked_type[(size_t)k] = type;
+		}
+		else
+		{
+			err = ChannelsToMx(session, images, type, &values[(size_t)k]);
+		}
+	}
+	if (err == H_MSG_TRUE)
+	{
+		int ret = 0;
+		if (values.size() == 1)
+		{
+			if (values[0] != NULL)
+			{
+				ret = HMatlabPutVariable(session, NAME.par.s, values[0]);
+			}
+		}
+		else
+		{
+			// 空着的元素先是 []
+			mxArray *C = mxCreateCellMatrix(1, values.size());
+			for (size_t k = 0; k < values.size(); k++)
+			{
+				mxSetCell(C, k, values[k]);
+			}
+			ret = HMatlabPutVariable(session, NAME.par.s, C);
+			for (size_t k = 0; k < values.size(); k++)
+			{
+				mxSetCell(C, k, NULL);
+			}
+			mxDestroyArray(C);
+		}
+		if (ret != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+	}
+	for (size_t k = 0; err == H_MSG_TRUE && k < chunked.size(); k++)
+	{
+		if (chunked_type[k] != NULL)
+		{
+			std::string target = NAME.par.s;
+			if (values.size() > 1)
+			{
+				target += "{" + std::to_string((unsigned long long)k + 1) + "}";
+			}
+			err = PutChunked(session, chunked[k], chunked_type[k], target);
+		}
+	}
+	for (size_t k = 0; k < values.size(); k++)
+	{
+		session.pool.Release(values[k]);
+	}
+	// 记下原图信息供 Matlab_engGetImage 贴回；整幅传输时清掉同名变量的旧记录
+	if (err == H_MSG_TRUE && !rois.empty())
+	{
+		session.image_rois[NAME.par.s].swap(rois);
+	}
+	else if (err == H_MSG_TRUE)
+	{
+		session.image_rois.erase(NAME.par.s);
+	}
+	// 整体重传后，Matlab_engUpdateImage 的块哈希不再对应
+	session.image_tiles.erase(NAME.par.s);
+	return err;
+}
+
+// ---------------------------------------------------------------------------
+// 增量更新：MATLAB 里常驻的图像只在部分块变化时，按 TileSize x TileSize 分块，
+// 和上次上传时的块哈希比较，只上传变化的块。变化的块打包成一个
+// TileSize x TileSize x channels x n 数组一次 put，再用一条 eval 逐块赋值进去。
+// 比较的是本模块上次上传的内容；MATLAB 端自己改过这个变量不会被察觉。
+// 每块只保存一个 64 位非加密哈希 (HMatlabHashBytes)，不保留上次的像素，哈希相同时不再逐字节比较：
+// 内容变了而哈希恰好相同的块会被当作没变，MATLAB 端留着旧像素。随机内容下每块的概率约 2^-64，
+// 但哈希不抗人为构造的碰撞。不能接受这一点时用 Matlab_engPutImage 整幅上传 (同时清掉块哈希)。
+
+// 一个块所有通道的哈希
+static uint64_t TileHash(const std::vector<Himage> &images, size_t bytes, size_t r0, size_t c0,
+						 size_t h, size_t w)
+{
+	size_t width = (size_t)images[0].width;
+	uint64_t hash = 0x243F6A8885A308D3ULL;
+	for (size_t c = 0; c < images.size(); c++)
+	{
+		const char *pixels = (const char *)images[c].pixel.p;
+		for (size_t r = r0; r < r0 + h; r++)
+		{
+			hash = HMatlabHashBytes(pixels + (r * width + c0) * bytes, w * bytes, hash);
+		}
+	}
+	return hash;
+}
+
+Herror HMatlab_engUpdateImage(Hproc_handle proc_handle)
+{
+	Hcpar NAME, TileSize;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetSPar(proc_handle, 2, LONG_PAR, &TileSize, 1);
+	if (TileSize.par.l < 1)
+	{
+		return H_ERR_WIPV2;
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	INT4_8 num_obj;
+	HCkP(HGetObjNum(proc_handle, 1, &num_obj));
+	if (num_obj != 1)
+	{
+		return H_ERR_WIPN1;
+	}
+	Hkey key;
+	std::vector<Himage> images;
+	const HMatlabPixelType *type;
+	HCkP(HGetObj(proc_handle, 1, 1, &key));
+	HCkP(ReadChannels(proc_handle, key, &images, &type));
+
+	size_t tile = (size_t)TileSize.par.l;
+	size_t height = (size_t)images[0].height;
+	size_t width = (size_t)images[0].width;
+	size_t tiles_y = (height + tile - 1) / tile;
+	size_t tiles_x = (width + tile - 1) / tile;
+	std::vector<uint64_t> hashes(tiles_y * tiles_x);
+	for (size_t ty = 0; ty < tiles_y; ty++)
+	{
+		for (size_t tx = 0; tx < tiles_x; tx++)
+		{
+			size_t r0 = ty * tile, c0 = tx * tile;
+			hashes[ty * tiles_x + tx] = TileHash(images, type->bytes, r0, c0, std::min(tile, height - r0),
+												 std::min(tile, width - c0));
+		}
+	}
+	std::vector<size_t> changed;
+	std::map<std::string, HMatlabImageTiles>::iterator it = session.image_tiles.find(NAME.par.s);
+	bool same_layout = it != session.image_tiles.end() && it->second.width == width &&
+					   it->second.height == height && it->second.channels == images.size() &&
+					   it->second.tile == tile && it->second.kind == (int)type->kind;
+	for (size_t i = 0; i < hashes.size(); i++)
+	{
+		if (!same_layout || it->second.hashes[i] != hashes[i])
+		{
+			changed.push_back(i);
+		}
+	}
+
+	Herror err = H_MSG_TRUE;
+	if (!same_layout || changed.size() * 2 > hashes.size())
+	{
+		// 第一次、尺寸变了或者过半的块都变了：整幅上传更省事，输出全部块
+		changed.resize(hashes.size());
+		for (size_t i = 0; i < changed.size(); i++)
+		{
+			changed[i] = i;
+		}
+		mxArray *A;
+		HCkP(ChannelsToMx(session, images, type, &A));
+		err = HMatlabPutVariable(session, NAME.par.s, A) == 0 ? H_MSG_TRUE : H_ERR_MATLAB_ENGINE;
+		session.pool.Release(A);
+	}
+	else if (!changed.empty())
+	{
+		mwSize dims[4] = {tile, tile, (mwSize)images.size(), (mwSize)changed.size()};
+		mxArray *T = mxCreateUninitNumericArray(4, dims, type->cls, type->complexity);
+		if (T == NULL)
+		{
+			return H_ERR_MEM;
+		}
+		char *data = type->complexity == mxCOMPLEX ? (char *)mxGetComplexSingles(T) : (char *)mxGetData(T);
+		size_t plane = tile * tile * type->bytes;
+		// 命名空间里的变量直接改结构体的字段，只写变了的块，不经过 hm_ns_exec__ 复制整幅图像
+		std::string target = HMatlabNamespaceRef(NAME.par.s);
+		std::string cmd;
+		for (size_t k = 0; k < changed.size(); k++)
+		{
+			size_t r0 = changed[k] / tiles_x * tile, c0 = changed[k] % tiles_x * tile;
+			size_t h = std::min(tile, height - r0), w = std::min(tile, width - c0);
+			for (size_t c = 0; c < images.size(); c++)
+			{
+				// 边缘的块不满，只填左上角 h x w，列距仍是 tile
+				const char *pixels = (const char *)images[c].pixel.p + (r0 * width + c0) * type->bytes;
+				Transpose(pixels, width, data + (k * images.size() + c) * plane, tile, h, w, type->bytes);
+			}
+			char buf[160];
+			snprintf(buf, sizeof(buf), "(%llu:%llu,%llu:%llu,:)=hm_tiles__(1:%llu,1:%llu,:,%llu);",
+					 (unsigned long long)r0 + 1, (unsigned long long)(r0 + h), (unsigned long long)c0 + 1,
+					 (unsigned long long)(c0 + w), (unsigned long long)h, (unsigned long long)w,
+					 (unsigned long long)k + 1);
+			cmd += target + buf;
+		}
+		HMatlabNamespaceGuard base("");
+		if (HMatlabPutVariable(session, "hm_tiles__", T) != 0 || HMatlabEval(session, cmd.c_str()) != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+		mxDestroyArray(T);
+		HMatlabClearLater(session, "hm_tiles__");
+	}
+	if (err != H_MSG_TRUE)
+	{
+		session.image_tiles.erase(NAME.par.s);
+		return err;
+	}
+	HMatlabImageTiles &state = session.image_tiles[NAME.par.s];
+	state.width = width;
+	state.height = height;
+	state.channels = images.size();
+	state.tile = tile;
+	state.kind = (int)type->kind;
+	state.hashes.swap(hashes);
+	session.image_rois.erase(NAME.par.s);
+
+	// 输出变化的块左上角坐标 (从 0 开始)；整幅上传时是全部块
+	Hlong *rows, *cols;
+	HCkP(HAllocTmp(proc_handle, &rows, changed.size() * sizeof(Hlong) + 1));
+	HCkP(HAllocTmp(proc_handle, &cols, changed.size() * sizeof(Hlong) + 1));
+	for (size_t k = 0; k < changed.size(); k++)
+	{
+		rows[k] = (Hlong)(changed[k] / tiles_x * tile);
+		cols[k] = (Hlong)(changed[k] % tiles_x * tile);
+	}
+	HCkP(HPutElem(proc_handle, 1, rows, (INT4_8)changed.size(), LONG_PAR));
+	HCkP(HPutElem(proc_handle, 2, cols, (INT4_8)changed.size(), LONG_PAR));
+	return H_MSG_TRUE;
+}
+
+// ---------------------------------------------------------------------------
+// MATLAB -> HALCON
+
+// 新建一个定义域为整幅图的对象
+static Herror NewFullObject(Hproc_handle proc_handle, size_t height, size_t width, Hkey *key)
+{
+	Hrlregion *region;
+	HCkP(HAllocRLNumTmp(proc_handle, &region, height));
+	for (size_t r = 0; r < height; r++)
+	{
+		region->rl[r].l = (HIMGCOOR)r;
+		region->rl[r].cb = 0;
+		region->rl[r].ce = (HIMGCOOR)(width - 1);
+	}
+	region->num = (HITEMCNT)height;
+	region->is_compl = FALSE;
+	Herror err = HPutDRL(proc_handle, UNDEF_KEY, region, key);
+	HFreeRLTmp(proc_handle, region);
+	return err;
+}
+
+// double 在 HALCON 里没有对应的像素类型，实数转 real、复数转 complex (单精度)
+template <typename Src, typename Dst>
+static void ConvertTransposed(const Src *src, Dst *dst, size_t height, size_t width)
+{
+	for (size_t r = 0; r < height; r++)
+	{
+		for (size_t c = 0; c < width; c++)
+		{
+			dst[r * width + c] = (Dst)src[c * height + r];
+		}
+	}
+}
+
+static void ConvertTransposedComplex(const mxComplexDouble *src, HComplexPixel *dst, size_t height, size_t width)
+{
+	for (size_t r = 0; r < height; r++)
+	{
+		for (size_t c = 0; c < width; c++)
+		{
+			dst[r * width + c].re = (float)src[c * height + r].real;
+			dst[r * width + c].im = (float)src[c * height + r].imag;
+		}
+	}
+}
+
+// 数组元素对应的像素类型；不能转成图像时返回 NULL
+static const HMatlabPixelType *MxPixelType(const mxArray *A)
+{
+	if ((!mxIsNumeric(A) && !mxIsLogical(A)) || mxIsSparse(A))
+	{
+		return NULL;
+	}
+	bool complex = mxIsComplex(A) != 0;
+	if (mxIsLogical(A))
+	{
+		return PixelTypeByKind(BYTE_IMAGE);
+	}
+	if (mxIsDouble(A))
+	{
+		return PixelTypeByKind(complex ? COMPLEX_IMAGE : FLOAT_IMAGE);
+	}
+	return PixelTypeByClass(mxGetClassID(A), complex);
+}
+
+// 数组对应的像素类型和尺寸；不能转成图像时返回 NULL
+static const HMatlabPixelType *MxImageType(const mxArray *A, size_t *height, size_t *width, size_t *channels)
+{
+	mwSize ndim = mxGetNumberOfDimensions(A);
+	if (ndim > 3)
+	{
+		return NULL;
+	}
+	const mwSize *dims = mxGetDimensions(A);
+	*height = dims[0];
+	*width = dims[1];
+	*channels = ndim == 3 ? dims[2] : 1;
+	if (*height == 0 || *width == 0 || *channels == 0 || !FitsImage(*height, *width))
+	{
+		return NULL;
+	}
+	return MxPixelType(A);
+}
+
+// 把第 c 个通道转置 (必要时转换类型) 写进按行存放的 dst
+static void FillChannel(const mxArray *A, const HMatlabPixelType *type, size_t c,
+						size_t height, size_t width, void *dst)
+{
+	size_t plane = height * width;
+	if (mxIsDouble(A) && mxIsComplex(A))
+	{
+		ConvertTransposedComplex(mxGetComplexDoubles(A) + c * plane, (HComplexPixel *)dst, height, width);
+	}
+	else if (mxIsDouble(A))
+	{
+		ConvertTransposed(mxGetDoubles(A) + c * plane, (float *)dst, height, width);
+	}
+	else
+	{
+		// logical 和 uint8 都是 1 字节，直接转置。按列存放的 height x width
+		// 就是按行存放的 width x height
+		const char *data = mxIsComplex(A) ? (const char *)mxGetComplexSingles(A) : (const char *)mxGetData(A);
+		Transpose(data + HMatlabPlaneOffset(c, height, width, type->bytes), dst, width, height, type->bytes);
+	}
+}
+
+static Herror MxToImage(Hproc_handle proc_handle, const mxArray *A)
+{
+	size_t height, width, channels;
+	const HMatlabPixelType *type = MxImageType(A, &height, &width, &channels);
+	if (type == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	Hkey key;
+	HCkP(NewFullObject(proc_handle, height, width, &key));
+	for (size_t c = 0; c < channels; c++)
+	{
+		Himage image;
+		HCkP(HNewImage(proc_handle, &image, type->kind, (HIMGDIM)width, (HIMGDIM)height));
+		FillChannel(A, type, c, height, width, image.pixel.p);
+		HCkP(HPutImage(proc_handle, key, (INT)(c + 1), &image, FALSE));
+	}
+	return H_MSG_TRUE;
+}
+
+// 不在算子输出参数里、而是作为普通 HObject 使用 (例如放进字典) 时走 gen_image1
+Herror HMatlabMxToImageObject(const mxArray *A, HalconCpp::HObject *image)
+{
+	size_t height, width, channels;
+	const HMatlabPixelType *type = MxImageType(A, &height, &width, &channels);
+	if (type == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	std::vector<char> buffer(height * width * type->bytes);
+	HalconCpp::HObject all;
+	HalconCpp::GenEmptyObj(&all);
+	for (size_t c = 0; c < channels; c++)
+	{
+		FillChannel(A, type, c, height, width, buffer.data());
+		HalconCpp::HObject channel;
+		HalconCpp::GenImage1(&channel, type->name, (Hlong)width, (Hlong)height, (Hlong)buffer.data());
+		HalconCpp::ConcatObj(all, channel, &all);
+	}
+	if (channels == 1)
+	{
+		*image = all;
+	}
+	else
+	{
+		HalconCpp::ChannelsToImage(all, image);
+	}
+	return H_MSG_TRUE;
+}
+
+// 分片取回时 MATLAB 端先转换成图像对应的类，每片都按图像像素的大小传输
+struct HMatlabChunkClass
+{
+	const char *matlab;
+	mxClassID cls;
+	const char *cast;
+};
+
+static const HMatlabChunkClass kChunkClasses[] = {
+	{"uint8", mxUINT8_CLASS, ""},
+	{"logical", mxUINT8_CLASS, "uint8"},
+	{"int8", mxINT8_CLASS, ""},
+	{"uint16", mxUINT16_CLASS, ""},
+	{"int16", mxINT16_CLASS, ""},
+	{"int32", mxINT32_CLASS, ""},
+	{"int64", mxINT64_CLASS, ""},
+	{"single", mxSINGLE_CLASS, ""},
+	{"double", mxSINGLE_CLASS, "single"},
+};
+
+// 超过 chunk_bytes 的数组按列分片取回，直接写进新图像，不在内存里同时保留整个 mxArray。
+// 先用一次小查询拿到尺寸和类型；不需要分片 (元胞、太小、不是数值) 时 *chunked 为 false
+static Herror GetChunked(Hproc_handle proc_handle, HMatlabSession &session, const std::string &var,
+						 bool *chunked)
+{
+	*chunked = false;
+	// 命名空间里的变量直接读结构体的字段，每片不经过 hm_ns_exec__
+	std::string name = HMatlabNamespaceRef(var);
+	HMatlabNamespaceGuard base("");
+	std::string classes;
+	for (size_t i = 0; i < sizeof(kChunkClasses) / sizeof(kChunkClasses[0]); i++)
+	{
+		classes += (i ? ",'" : "'") + std::string(kChunkClasses[i].matlab) + "'";
+	}
+	std::string cmd = "hm_info__=[size(" + name + ",1),size(" + name + ",2),size(" + name + ",3),ndims(" +
+					  name + "),~isreal(" + name + "),issparse(" + name + "),max([0,find(strcmp(class(" +
+					  name + "),{" + classes + "}),1)])];";
+	if (HMatlabEvalNow(session, cmd.c_str()) != 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	mxArray *info = HMatlabGetVariable(session, "hm_info__");
+	HMatlabClearLater(session, "hm_info__");
+	if (info == NULL || !mxIsDouble(info) || mxGetNumberOfElements(info) != 7)
+	{
+		if (info != NULL)
+		{
+			mxDestroyArray(info);
+		}
+		return H_ERR_MATLAB_ENGINE;
+	}
+	const double *v = mxGetDoubles(info);
+	size_t height = (size_t)v[0], width = (size_t)v[1], channels = (size_t)v[2];
+	bool complex = v[4] != 0;
+	bool usable = v[3] <= 3 && v[5] == 0 && v[6] >= 1;
+	size_t index = usable ? (size_t)v[6] - 1 : 0;
+	mxDestroyArray(info);
+	const HMatlabPixelType *type = usable ? PixelTypeByClass(kChunkClasses[index].cls, complex) : NULL;
+	if (type == NULL || height * width * channels == 0 || !FitsImage(height, width) ||
+		height * width * channels * type->bytes <= session.chunk_bytes)
+	{
+		return H_MSG_TRUE;
+	}
+	*chunked = true;
+
+	// 复数片里虚部全为 0 时 MATLAB 的下标运算会丢掉虚部，用 complex() 保留
+	std::string open = kChunkClasses[index].cast;
+	open += open.empty() ? "" : "(";
+	std::string close = open.empty() ? "" : ")";
+	if (complex)
+	{
+		open = "complex(" + open;
+		close += ")";
+	}
+	Hkey key;
+	HCkP(NewFullObject(proc_handle, height, width, &key));
+	size_t step = ChunkColumns(session, height, type->bytes);
+	Herror err = H_MSG_TRUE;
+	for (size_t c = 0; err == H_MSG_TRUE && c < channels; c++)
+	{
+		Himage image;
+		HCkP(HNewImage(proc_handle, &image, type->kind, (HIMGDIM)width, (HIMGDIM)height));
+		char *pixels = (char *)image.pixel.p;
+		for (size_t col = 0; err == H_MSG_TRUE && col < width; col += step)
+		{
+			size_t n = step < width - col ? step : width - col;
+			cmd = "hm_chunk__=" + open + name + "(:," + std::to_string((unsigned long long)col + 1) + ":" +
+				  std::to_string((unsigned long long)(col + n)) + "," + std::to_string((unsigned long long)c + 1) +
+				  ")" + close + ";";
+			mxArray *slab = HMatlabEvalNow(session, cmd.c_str()) == 0 ? HMatlabGetVariable(session, "hm_chunk__") : NULL;
+			if (slab == NULL || mxGetClassID(slab) != type->cls || (mxIsComplex(slab) != 0) != complex ||
+				mxGetM(slab) != height || mxGetN(slab) != n)
+			{
+				err = H_ERR_MATLAB_ENGINE;
+			}
+			else
+			{
+				// 按列存放的 height x n 就是按行存放的 n x height，写进新图像的第 col 列起
+				const char *data = complex ? (const char *)mxGetComplexSingles(slab) : (const char *)mxGetData(slab);
+				Transpose(data, height, pixels + col * type->bytes, width, n, height, type->bytes);
+			}
+			if (slab != NULL)
+			{
+				mxDestroyArray(slab);
+			}
+		}
+		if (err == H_MSG_TRUE)
+		{
+			err = HPutImage(proc_handle, key, (INT)(c + 1), &image, FALSE);
+		}
+	}
+	HMatlabClearLater(session, "hm_chunk__");
+	return err;
+}
+
+// 按记录的原图信息贴回：新图像是原尺寸，定义域是原定义域，定义域外的像素为 0。
+// mode 为 'bbox' 时 A 是 rows x cols [x channels]，为 'domain' 时是 count x channels
+// (或 Matlab_engPutImage 给出的结构体，取其中的 pixels)
+static Herror PasteRoi(Hproc_handle proc_handle, const mxArray *A, const HMatlabImageRoi &roi,
+					   const std::string &mode)
+{
+	if (mxIsStruct(A) && mxGetNumberOfElements(A) == 1 && mxGetField(A, 0, "pixels") != NULL)
+	{
+		A = mxGetField(A, 0, "pixels");
+	}
+	const HMatlabPixelType *type = MxPixelType(A);
+	mwSize ndim = mxGetNumberOfDimensions(A);
+	const mwSize *dims = mxGetDimensions(A);
+	size_t channels;
+	if (type == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	if (mode == "bbox")
+	{
+		if (ndim > 3 || dims[0] != roi.rows || dims[1] != roi.cols)
+		{
+			return H_ERR_MATLAB_ENGINE;
+		}
+		channels = ndim == 3 ? dims[2] : 1;
+	}
+	else
+	{
+		if (ndim != 2 || dims[0] != roi.count)
+		{
+			return H_ERR_MATLAB_ENGINE;
+		}
+		channels = dims[1];
+	}
+	if (channels == 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	Hrlregion *region;
+	Hkey key;
+	HCkP(HAllocRLNumTmp(proc_handle, &region, roi.runs.size() / 3));
+	for (size_t i = 0; i < roi.runs.size() / 3; i++)
+	{
+		region->rl[i].l = (HIMGCOOR)roi.runs[i * 3];
+		region->rl[i].cb = (HIMGCOOR)roi.runs[i * 3 + 1];
+		region->rl[i].ce = (HIMGCOOR)roi.runs[i * 3 + 2];
+	}
+	region->num = (HITEMCNT)(roi.runs.size() / 3);
+	region->is_compl = FALSE;
+	Herror err = HPutDRL(proc_handle, UNDEF_KEY, region, &key);
+	HFreeRLTmp(proc_handle, region);
+	HCkP(err);
+
+	// 先转成按行存放的一块 (外接矩形或 count 个像素)，再拷进整幅图
+	size_t bytes = type->bytes;
+	std::vector<char> buffer(mode == "bbox" ? roi.rows * roi.cols * bytes : roi.count * bytes);
+	// mxLogical 在 C++ 里是 bool，不能放进 std::vector
+	std::unique_ptr<mxLogical[]> mask;
+	if (mode != "bbox")
+	{
+		mask.reset(new mxLogical[roi.rows * roi.cols]);
+		BuildMask(roi, mask.get());
+	}
+	for (size_t c = 0; c < channels; c++)
+	{
+		Himage image;
+		HCkP(HNewImage(proc_handle, &image, type->kind, (HIMGDIM)roi.width, (HIMGDIM)roi.height));
+		char *pixels = (char *)image.pixel.p;
+		memset(pixels, 0, roi.width * roi.height * bytes);
+		if (mode == "bbox")
+		{
+			FillChannel(A, type, c, roi.rows, roi.cols, buffer.data());
+			for (size_t row = 0; row < roi.rows; row++)
+			{
+				memcpy(pixels + ((roi.row0 + row) * roi.width + roi.col0) * bytes,
+					   buffer.data() + row * roi.cols * bytes, roi.cols * bytes);
+			}
+		}
+		else
+		{
+			FillChannel(A, type, c, roi.count, 1, buffer.data());
+			const char *src = buffer.data();
+			for (size_t col = 0; col < roi.cols; col++)
+			{
+				for (size_t row = 0; row < roi.rows; row++)
+				{
+					if (mask[col * roi.rows + row])
+					{
+						memcpy(pixels + ((roi.row0 + row) * roi.width + roi.col0 + col) * bytes, src, bytes);
+						src += bytes;
+					}
+				}
+			}
+		}
+		HCkP(HPutImage(proc_handle, key, (INT)(c + 1), &image, FALSE));
+	}
+	return H_MSG_TRUE;
+}
+
+// 'auto' 时按数组形状判断是否贴回：和记录的外接矩形同尺寸按 'bbox'，
+// 行数等于定义域像素数按 'domain'，否则当作整幅图
+static std::string RoiModeFor(const mxArray *A, const HMatlabImageRoi &roi)
+{
+	if (mxIsStruct(A) && mxGetNumberOfElements(A) == 1 && mxGetField(A, 0, "pixels") != NULL)
+	{
+		A = mxGetField(A, 0, "pixels");
+	}
+	mwSize ndim = mxGetNumberOfDimensions(A);
+	const mwSize *dims = mxGetDimensions(A);
+	if (roi.mode == "bbox" && ndim <= 3 && dims[0] == roi.rows && dims[1] == roi.cols)
+	{
+		return "bbox";
+	}
+	if (roi.mode == "domain" && ndim == 2 && dims[0] == roi.count)
+	{
+		return "domain";
+	}
+	return "full";
+}
+
+static Herror GetOne(Hproc_handle proc_handle, const mxArray *A, const std::string &mode,
+					 const HMatlabImageRoi *roi)
+{
+	if (A == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	std::string use = mode;
+	if (mode == "auto")
+	{
+		use = roi != NULL ? RoiModeFor(A, *roi) : "full";
+	}
+	if (use == "full")
+	{
+		return MxToImage(proc_handle, A);
+	}
+	return roi != NULL ? PasteRoi(proc_handle, A, *roi, use) : H_ERR_WIPV3;
+}
+
+Herror HMatlab_engGetImage(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_gen_name, num_gen_value;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 2, &GenParamName, &num_gen_name);
+	HGetPPar(proc_handle, 3, &GenParamValue, &num_gen_value);
+	if (num_gen_name != num_gen_value)
+	{
+		return H_ERR_WIPN3;
+	}
+	// 'roi'：'auto' (默认) 有记录且形状吻合时贴回，'full' 不贴回，'bbox' / 'domain' 强制贴回。
+	// 'roi_source'：用哪个 Matlab_engPutImage 变量的记录，默认就是 NAME
+	std::string roi_mode = "auto";
+	std::string source = NAME.par.s;
+	for (INT4_8 i = 0; i < num_gen_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT2;
+		}
+		std::string name = GenParamName[i].par.s;
+		if (name == "roi")
+		{
+			roi_mode = HMatlabParString(GenParamValue[i]);
+			if (roi_mode != "auto" && roi_mode != "full" && roi_mode != "bbox" && roi_mode != "domain")
+			{
+				return H_ERR_WIPV3;
+			}
+		}
+		else if (name == "roi_source")
+		{
+			source = HMatlabParString(GenParamValue[i]);
+		}
+		else
+		{
+			return H_ERR_WIPV2;
+		}
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	std::map<std::string, std::vector<HMatlabImageRoi> >::const_iterator it = session.image_rois.find(source);
+	const std::vector<HMatlabImageRoi> *rois = it != session.image_rois.end() ? &it->second : NULL;
+	if (rois == NULL && (roi_mode == "bbox" || roi_mode == "domain"))
+	{
+		return H_ERR_WIPV3; // 没有对应的记录，无法贴回
+	}
+	if (session.chunk_bytes > 0 && rois == NULL)
+	{
+		bool chunked;
+		Herror err = GetChunked(proc_handle, session, NAME.par.s, &chunked);
+		if (err != H_MSG_TRUE || chunked)
+		{
+			return err;
+		}
+	}
+	mxArray *A = HMatlabGetVariable(session, NAME.par.s);
+	if (A == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	Herror err = H_MSG_TRUE;
+	if (mxIsCell(A))
+	{
+		size_t num = mxGetNumberOfElements(A);
+		for (size_t k = 0; err == H_MSG_TRUE && k < num; k++)
+		{
+			const HMatlabImageRoi *roi = rois != NULL && rois->size() == num ? &(*rois)[k] : NULL;
+			err = GetOne(proc_handle, mxGetCell(A, k), roi_mode, roi);
+		}
+	}
+	else
+	{
+		const HMatlabImageRoi *roi = rois != NULL && rois->size() == 1 ? &(*rois)[0] : NULL;
+		err = GetOne(proc_handle, A, roi_mode, roi);
+	}
+	mxDestroyArray(A);
+	return err;
+}
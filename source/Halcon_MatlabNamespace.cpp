@@ -0,0 +1,169 @@
+#include "Halcon_MatlabNamespace.h"
+#include "Halcon_MatlabPromote.h"
+#include <cctype>
+#include <cstdio>
+#include <mutex>
+
+// 变量名最长 63 个字符，留出 hm_ns_ 和 __
+static const size_t kMaxIdLength = 55;
+
+static thread_local std::string tls_namespace;
+
+// 局部变量都以 hm_ns_ 开头，写回时跳过；其余 hm_*__ 是基本工作区的临时变量
+static const char kExecScript[] =
+	"function hm_ns_exec__(hm_ns_name__, hm_ns_cmd__)\n"
+	"if evalin('base', ['exist(''' hm_ns_name__ ''',''var'')'])\n"
+	"    hm_ns_s__ = evalin('base', hm_ns_name__);\n"
+	"    hm_ns_f__ = fieldnames(hm_ns_s__);\n"
+	"    for hm_ns_i__ = 1:numel(hm_ns_f__)\n"
+	"        eval([hm_ns_f__{hm_ns_i__} '=hm_ns_s__.' hm_ns_f__{hm_ns_i__} ';']);\n"
+	"    end\n"
+	"end\n"
+	"hm_ns_f__ = evalin('base', 'who(''hm_*__'')');\n"
+	"for hm_ns_i__ = 1:numel(hm_ns_f__)\n"
+	"    if ~strncmp(hm_ns_f__{hm_ns_i__}, 'hm_ns_', 6)\n"
+	"        eval([hm_ns_f__{hm_ns_i__} '=evalin(''base'',''' hm_ns_f__{hm_ns_i__} ''');']);\n"
+	"    end\n"
+	"end\n"
+	"clear hm_ns_s__ hm_ns_f__ hm_ns_i__\n"
+	"hm_ns_e__ = [];\n"
+	"try\n"
+	"    eval(hm_ns_cmd__);\n"
+	"catch hm_ns_e__\n"
+	"end\n"
+	"hm_ns_s__ = struct();\n"
+	"hm_ns_f__ = who;\n"
+	"for hm_ns_i__ = 1:numel(hm_ns_f__)\n"
+	"    hm_ns_v__ = hm_ns_f__{hm_ns_i__};\n"
+	"    if strncmp(hm_ns_v__, 'hm_ns_', 6)\n"
+	"        continue;\n"
+	"    elseif strncmp(hm_ns_v__, 'hm_', 3) && numel(hm_ns_v__) > 5 && strcmp(hm_ns_v__(end-1:end), '__')\n"
+	"        assignin('base', hm_ns_v__, eval(hm_ns_v__));\n"
+	"    else\n"
+	"        hm_ns_s__.(hm_ns_v__) = eval(hm_ns_v__);\n"
+	"    end\n"
+	"end\n"
+	"assignin('base', hm_ns_name__, hm_ns_s__);\n"
+	"if ~isempty(hm_ns_e__)\n"
+	"    rethrow(hm_ns_e__);\n"
+	"end\n";
+
+namespace
+{
+// 生成的函数每个进程写一次，进程退出时删除
+struct ExecScript
+{
+	ExecScript() : written(false) {}
+	~ExecScript()
+	{
+		if (written)
+		{
+			std::remove(path.c_str());
+		}
+	}
+
+	std::mutex mutex;
+	std::string dir, path;
+	bool written;
+};
+}
+
+static bool WriteExecScript(std::string *dir)
+{
+	static ExecScript script;
+	std::lock_guard<std::mutex> lock(script.mutex);
+	if (!script.written)
+	{
+		script.dir = HMatlabPrivateDir();
+		script.path = script.dir + "hm_ns_exec__.m";
+		FILE *f = fopen(script.path.c_str(), "wb");
+		if (f == NULL)
+		{
+			return false;
+		}
+		bool ok = fputs(kExecScript, f) >= 0;
+		ok = fclose(f) == 0 && ok;
+		if (!ok)
+		{
+			std::remove(script.path.c_str());
+			return false;
+		}
+		script.written = true;
+	}
+	*dir = script.dir;
+	return true;
+}
+
+bool HMatlabIsNamespaceId(const std::string &id)
+{
+	if (id.size() > kMaxIdLength)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < id.size(); i++)
+	{
+		if (!isalnum((unsigned char)id[i]) && id[i] != '_')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const std::string &HMatlabThreadNamespace()
+{
+	return tls_namespace;
+}
+
+void HMatlabSetThreadNamespace(const std::string &id)
+{
+	tls_namespace = id;
+}
+
+std::string HMatlabNamespaceVar(const std::string &id)
+{
+	return "hm_ns_" + id + "__";
+}
+
+std::string HMatlabNamespaceRef(const std::string &expr)
+{
+	return tls_namespace.empty() ? expr : HMatlabNamespaceVar(tls_namespace) + "." + expr;
+}
+
+// 放进 MATLAB 的字符串表达式。单引号字符串里不能换行，换行符用 char(10) 拼接
+static std::string Literal(const std::string &text)
+{
+	std::string out = "['";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '\'')
+		{
+			out += "''";
+		}
+		else if (text[i] == '\n' || text[i] == '\r')
+		{
+			out += text[i] == '\n' ? "' char(10) '" : "' char(13) '";
+		}
+		else
+		{
+			out += text[i];
+		}
+	}
+	return out + "']";
+}
+
+std::string HMatlabNamespaceWrap(const std::string &id, const std::string &cmd, bool *path_added)
+{
+	std::string prefix;
+	if (!*path_added)
+	{
+		std::string dir;
+		if (!WriteExecScript(&dir))
+		{
+			return std::string();
+		}
+		prefix = "addpath('" + HMatlabQuote(dir) + "');";
+		*path_added = true;
+	}
+	return prefix + "hm_ns_exec__('" + HMatlabNamespaceVar(id) + "'," + Literal(cmd) + ");";
+}
@@ -0,0 +1,213 @@
+﻿#include "Halcon_MatlabPool.h"
+#include "Halcon_MatlabSize.h"
+#include <cstdint>
+
+// 各数值类型单个实数元素的字节数，非数值类型返回 0（不进池）
+static size_t ElementBytes(mxClassID cls)
+{
+	switch (cls)
+	{
+	case mxDOUBLE_CLASS:
+	case mxINT64_CLASS:
+	case mxUINT64_CLASS:
+		return 8;
+	case mxSINGLE_CLASS:
+	case mxINT32_CLASS:
+	case mxUINT32_CLASS:
+		return 4;
+	case mxINT16_CLASS:
+	case mxUINT16_CLASS:
+		return 2;
+	case mxINT8_CLASS:
+	case mxUINT8_CLASS:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+HMatlabMxPool::HMatlabMxPool()
+	: max_bytes_((size_t)256 << 20), idle_bytes_(0), in_use_bytes_(0),
+	  high_water_bytes_(0), hits_(0), misses_(0)
+{
+}
+
+HMatlabMxPool::~HMatlabMxPool()
+{
+	Clear();
+}
+
+int HMatlabMxPool::Key(mxClassID cls, mxComplexity complexity)
+{
+	return (int)cls * 2 + (complexity == mxCOMPLEX ? 1 : 0);
+}
+
+mxArray *HMatlabMxPool::Acquire(mxClassID cls, mxComplexity complexity, size_t rows, size_t cols)
+{
+	size_t elem = ElementBytes(cls) * (complexity == mxCOMPLEX ? 2 : 1);
+	// rows * cols * elem 溢出 size_t 时按分配失败处理
+	if (!HMatlabBytesFit(rows, cols, elem))
+	{
+		return NULL;
+	}
+	size_t need = rows * cols * elem;
+	Slot slot;
+	slot.A = NULL;
+	slot.capacity = need;
+	slot.key = Key(cls, complexity);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::multimap<size_t, Slot> &group = idle_[slot.key];
+		auto it = group.lower_bound(need);
+		// 容量超过需要的两倍就不复用，免得小数组长期占着大缓冲区
+		if (it != group.end() && it->first <= 2 * need + 4096)
+		{
+			slot = it->second;
+			group.erase(it);
+			idle_bytes_ -= slot.capacity;
+			hits_++;
+		}
+		else
+		{
+			misses_++;
+		}
+	}
+
+	if (slot.A != NULL)
+	{
+		// 缓冲区够大，只改维度；数据区不会重新分配
+		mwSize dims[2] = {rows, cols};
+		if (mxSetDimensions(slot.A, dims, 2) != 0)
+		{
+			mxDestroyArray(slot.A);
+			slot.A = NULL;
+			slot.capacity = need;
+		}
+	}
+	if (slot.A == NULL)
+	{
+		// 不做清零，调用方会整体覆盖数据
+		slot.A = mxCreateUninitNumericMatrix(rows, cols, cls, complexity);
+		if (slot.A == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	in_use_[slot.A] = slot;
+	in_use_bytes_ += slot.capacity;
+	if (idle_bytes_ + in_use_bytes_ > high_water_bytes_)
+	{
+		high_water_bytes_ = idle_bytes_ + in_use_bytes_;
+	}
+	return slot.A;
+}
+
+void HMatlabMxPool::Release(mxArray *A)
+{
+	if (A == NULL)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = in_use_.find(A);
+	if (it == in_use_.end())
+	{
+		mxDestroyArray(A); // 不是池里出去的，直接销毁
+		return;
+	}
+	Slot slot = it->second;
+	in_use_.erase(it);
+	in_use_bytes_ -= slot.capacity;
+	if (slot.capacity > max_bytes_)
+	{
+		mxDestroyArray(A);
+		return;
+	}
+	idle_[slot.key].insert(std::make_pair(slot.capacity, slot));
+	idle_bytes_ += slot.capacity;
+	TrimLocked();
+}
+
+// 空闲数组超过上限时，从容量最大的开始销毁
+void HMatlabMxPool::TrimLocked()
+{
+	while (idle_bytes_ + in_use_bytes_ > max_bytes_ && idle_bytes_ > 0)
+	{
+		std::multimap<size_t, Slot> *largest = NULL;
+		for (auto g = idle_.begin(); g != idle_.end(); ++g)
+		{
+			if (!g->second.empty() &&
+				(largest == NULL || g->second.rbegin()->first > largest->rbegin()->first))
+			{
+				largest = &g->second;
+			}
+		}
+		if (largest == NULL)
+		{
+			break;
+		}
+		auto last = std::prev(largest->end());
+		idle_bytes_ -= last->second.capacity;
+		mxDestroyArray(last->second.A);
+		largest->erase(last);
+	}
+}
+
+void HMatlabMxPool::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto g = idle_.begin(); g != idle_.end(); ++g)
+	{
+		for (auto it = g->second.begin(); it != g->second.end(); ++it)
+		{
+			mxDestroyArray(it->second.A);
+		}
+	}
+	idle_.clear();
+	idle_bytes_ = 0;
+}
+
+size_t HMatlabMxPool::MaxBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return max_bytes_;
+}
+
+void HMatlabMxPool::SetMaxBytes(size_t max_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_bytes_ = max_bytes;
+	TrimLocked();
+}
+
+uint64_t HMatlabMxPool::Hits()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hits_;
+}
+
+uint64_t HMatlabMxPool::Misses()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return misses_;
+}
+
+size_t HMatlabMxPool::IdleBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return idle_bytes_;
+}
+
+size_t HMatlabMxPool::InUseBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return in_use_bytes_;
+}
+
+size_t HMatlabMxPool::HighWaterBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return high_water_bytes_;
+}
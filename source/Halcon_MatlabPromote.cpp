@@ -0,0 +1,385 @@
+﻿#include "Halcon_MatlabPromote.h"
+#include "Halcon_MatlabCache.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 文本太短时解析开销可以忽略，改写反而更长
+static const size_t kMinScriptLength = 32;
+// 只统计这么多种不同的文本，防止每次内容都不同的调用把表撑大
+static const size_t kMaxCandidates = 4096;
+
+static bool IsIdentChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static bool HasWord(const std::string &s, const char *word)
+{
+	size_t len = strlen(word);
+	for (size_t pos = s.find(word); pos != std::string::npos; pos = s.find(word, pos + 1))
+	{
+		bool left = pos == 0 || !IsIdentChar(s[pos - 1]);
+		bool right = pos + len >= s.size() || !IsIdentChar(s[pos + len]);
+		if (left && right)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HMatlabExtractTemplate(const std::string &script, std::string *templ, std::string *params)
+{
+	// clear 会把参数变量一起清掉；含 hm_p__ 的文本本身就是生成的
+	if (HasWord(script, "clear") || HasWord(script, "clearvars") || HasWord(script, "hm_p__") ||
+		HasWord(script, "function"))
+	{
+		return false;
+	}
+	templ->clear();
+	params->clear();
+	size_t n = script.size(), count = 0;
+	int depth = 0; // 括号层数，括号内的 , ; 不分隔语句
+	bool statement_start = true;
+	char prev = 0; // 上一个非空白字符
+	bool prev_space = false;
+	for (size_t i = 0; i < n;)
+	{
+		char c = script[i];
+		if (c == ' ' || c == '\t')
+		{
+			*templ += c;
+			prev_space = true;
+			i++;
+			continue;
+		}
+		if (c == '\n' || c == '\r' || c == ';' || c == ',')
+		{
+			*templ += c;
+			statement_start = statement_start || depth == 0;
+			prev = c;
+			prev_space = false;
+			i++;
+			continue;
+		}
+		if (c == '%' || (c == '.' && script.compare(i, 3, "...") == 0))
+		{
+			// 注释和续行符后面的内容原样保留
+			size_t end = script.find('\n', i);
+			end = end == std::string::npos ? n : end;
+			*templ += script.substr(i, end - i);
+			i = end;
+			continue;
+		}
+		bool transpose = c == '\'' && !prev_space &&
+						 (IsIdentChar(prev) || prev == ')' || prev == ']' || prev == '}' ||
+						  prev == '.' || prev == '\'');
+		if ((c == '\'' && !transpose) || c == '"')
+		{
+			// 字符串字面量，引号成对出现表示转义
+			size_t j = i + 1;
+			for (; j < n; j++)
+			{
+				if (script[j] == c)
+				{
+					if (j + 1 < n && script[j + 1] == c)
+					{
+						j++;
+						continue;
+					}
+					break;
+				}
+			}
+			j = j < n ? j + 1 : n;
+			*templ += script.substr(i, j - i);
+			prev = c;
+			prev_space = false;
+			statement_start = false;
+			i = j;
+			continue;
+		}
+		if (IsIdentChar(c) && !isdigit((unsigned char)c))
+		{
+			size_t j = i;
+			while (j < n && IsIdentChar(script[j]))
+			{
+				j++;
+			}
+			std::string word = script.substr(i, j - i);
+			static const char *keywords[] = {"for", "if", "elseif", "while", "switch", "case",
+											 "otherwise", "else", "end", "try", "catch", "return",
+											 "break", "continue", "global", "persistent", "parfor"};
+			bool keyword = false;
+			for (size_t w = 0; w < sizeof(keywords) / sizeof(keywords[0]); w++)
+			{
+				keyword = keyword || word == keywords[w];
+			}
+			if (statement_start && !keyword)
+			{
+				// 命令语法 (如 "hold on", "figure 1") 的参数是字符，不能改写
+				size_t k = j;
+				while (k < n && (script[k] == ' ' || script[k] == '\t'))
+				{
+					k++;
+				}
+				bool option = k + 1 < n && script[k] == '-' && script[k + 1] != ' ' && script[k + 1] != '=';
+				if (k > j && k < n && (IsIdentChar(script[k]) || option))
+				{
+					return false;
+				}
+			}
+			*templ += script.substr(i, j - i);
+			prev = script[j - 1];
+			prev_space = false;
+			statement_start = false;
+			i = j;
+			continue;
+		}
+		bool number_start = isdigit((unsigned char)c) ||
+							(c == '.' && i + 1 < n && isdigit((unsigned char)script[i + 1]));
+		if (number_start && !(prev == '.' && !prev_space))
+		{
+			size_t j = i;
+			while (j < n && isdigit((unsigned char)script[j]))
+			{
+				j++;
+			}
+			// 3.*x 里的点属于运算符
+			if (j < n && script[j] == '.' &&
+				!(j + 1 < n && strchr("*/\\^'", script[j + 1]) != NULL))
+			{
+				j++;
+				while (j < n && isdigit((unsigned char)script[j]))
+				{
+					j++;
+				}
+			}
+			if (j < n && (script[j] == 'e' || script[j] == 'E'))
+			{
+				size_t k = j + 1;
+				if (k < n && (script[k] == '+' || script[k] == '-'))
+				{
+					k++;
+				}
+				if (k < n && isdigit((unsigned char)script[k]))
+				{
+					j = k;
+					while (j < n && isdigit((unsigned char)script[j]))
+					{
+						j++;
+					}
+				}
+			}
+			std::string literal = script.substr(i, j - i);
+			if (j < n && (IsIdentChar(script[j])))
+			{
+				// 虚数 3i、十六进制 0x1F 等保持原样
+				while (j < n && IsIdentChar(script[j]))
+				{
+					j++;
+				}
+				*templ += script.substr(i, j - i);
+			}
+			else
+			{
+				char slot[32];
+				snprintf(slot, sizeof(slot), "hm_p__(%u)", (unsigned)++count);
+				*templ += slot;
+				*params += (count > 1 ? "," : "") + literal;
+			}
+			prev = script[j - 1];
+			prev_space = false;
+			statement_start = false;
+			i = j;
+			continue;
+		}
+		if (c == '(' || c == '[' || c == '{')
+		{
+			depth++;
+		}
+		else if ((c == ')' || c == ']' || c == '}') && depth > 0)
+		{
+			depth--;
+		}
+		*templ += c;
+		prev = c;
+		prev_space = false;
+		statement_start = false;
+		i++;
+	}
+	return true;
+}
+
+std::string HMatlabQuote(const std::string &text)
+{
+	std::string quoted;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		quoted += text[i];
+		if (text[i] == '\'')
+		{
+			quoted += '\'';
+		}
+	}
+	return quoted;
+}
+
+HMatlabPromoter::HMatlabPromoter() : path_added_(false), threshold_(16), hits_(0)
+{
+}
+
+std::string HMatlabPrivateDir()
+{
+	char buf[1024];
+#ifdef _WIN32
+	DWORD len = GetTempPathA(sizeof(buf), buf);
+	std::string dir = len > 0 && len < sizeof(buf) ? std::string(buf, len) : std::string(".\\");
+	snprintf(buf, sizeof(buf), "Halcon_Matlab_%lu", (unsigned long)GetCurrentProcessId());
+	dir += buf;
+	CreateDirectoryA(dir.c_str(), NULL);
+	return dir + "\\";
+#else
+	const char *tmp = getenv("TMPDIR");
+	snprintf(buf, sizeof(buf), "%s/Halcon_Matlab_%ld", tmp != NULL ? tmp : "/tmp", (long)getpid());
+	mkdir(buf, 0700);
+	return std::string(buf) + "/";
+#endif
+}
+
+bool HMatlabPromoter::WriteScript(const std::string &func, const std::string &templ)
+{
+	if (dir_.empty())
+	{
+		dir_ = HMatlabPrivateDir();
+	}
+	std::string path = dir_ + func + ".m";
+	FILE *f = fopen(path.c_str(), "wb");
+	if (f == NULL)
+	{
+		return false;
+	}
+	bool ok = fwrite(templ.data(), 1, templ.size(), f) == templ.size();
+	ok = fputs("\n", f) >= 0 && ok;
+	ok = fclose(f) == 0 && ok;
+	if (ok)
+	{
+		files_.push_back(path);
+	}
+	return ok;
+}
+
+std::string HMatlabPromoter::Rewrite(const std::string &script)
+{
+	if (script.size() < kMinScriptLength)
+	{
+		return script;
+	}
+	std::string templ, params;
+	if (!HMatlabExtractTemplate(script, &templ, &params))
+	{
+		return script;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (threshold_ == 0)
+	{
+		return script;
+	}
+	auto it = entries_.find(templ);
+	if (it == entries_.end())
+	{
+		if (entries_.size() >= kMaxCandidates)
+		{
+			// 表满时丢掉还没提升的候选，重新统计
+			for (auto e = entries_.begin(); e != entries_.end();)
+			{
+				e = e->second.func.empty() ? entries_.erase(e) : std::next(e);
+			}
+		}
+		Entry entry;
+		entry.count = 0;
+		it = entries_.insert(std::make_pair(templ, entry)).first;
+	}
+	Entry &entry = it->second;
+	entry.count++;
+
+	std::string prefix;
+	if (entry.func.empty())
+	{
+		if (entry.count < threshold_)
+		{
+			return script;
+		}
+		char func[32];
+		snprintf(func, sizeof(func), "hm_s_%016llx",
+				 (unsigned long long)HMatlabHashBytes(templ.data(), templ.size(), 0));
+		// 参数在脚本末尾清掉，不留在用户工作区
+		if (!WriteScript(func, params.empty() ? templ : templ + "\nclear hm_p__"))
+		{
+			entry.count = 0;
+			return script;
+		}
+		entry.func = func;
+		// 新文件要让 MATLAB 重新扫描一次路径
+		prefix = path_added_ ? "rehash;\n" : "addpath('" + HMatlabQuote(dir_) + "');rehash;\n";
+		path_added_ = true;
+	}
+	hits_++;
+	if (params.empty())
+	{
+		return prefix + entry.func + ";";
+	}
+	return prefix + "hm_p__=[" + params + "];" + entry.func + ";";
+}
+
+void HMatlabPromoter::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (size_t i = 0; i < files_.size(); i++)
+	{
+		remove(files_[i].c_str());
+	}
+	files_.clear();
+	entries_.clear();
+	path_added_ = false;
+	hits_ = 0;
+}
+
+size_t HMatlabPromoter::Threshold()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return threshold_;
+}
+
+void HMatlabPromoter::SetThreshold(size_t threshold)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	threshold_ = threshold;
+}
+
+uint64_t HMatlabPromoter::Hits()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hits_;
+}
+
+size_t HMatlabPromoter::Promoted()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return files_.size();
+}
+
+size_t HMatlabPromoter::Candidates()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size();
+}
@@ -0,0 +1,526 @@
+// HALCON 区域和 MATLAB 之间的传输。区域本身是行程编码 (行, 起始列, 结束列)，
+// 默认直接传行程，不展开成逐像素的图像：
+//   'runs'    int32 N x 3 矩阵 [row cb ce]，HALCON 坐标 (从 0 开始)
+//   'packed'  结构体 {bits, size}，bits 的布局与 bwpack / libmwbwpackc 相同：
+//             按列存放，每个 uint32 装同一列连续 32 行，最低位是最上面一行，
+//             MATLAB 里 bwunpack(s.bits, s.size(1)) 即得逻辑图像
+//   'logical' height x width 的 logical 图像，只在明确要求时才生成
+// 多个区域对应 1 x k 的元胞，每个元素按上面的格式存放。
+#include "Halcon_Matlab.h"
+#include "Halcon_MatlabConvert.h"
+#include "Halcon_MatlabParam.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+enum HMatlabRegionFormat
+{
+	HMatlabRegionRuns,
+	HMatlabRegionPacked,
+	HMatlabRegionLogical
+};
+
+struct HMatlabRun
+{
+	Hlong row, cb, ce;
+};
+
+static bool RunLess(const HMatlabRun &a, const HMatlabRun &b)
+{
+	return a.row != b.row ? a.row < b.row : a.cb < b.cb;
+}
+
+// ---------------------------------------------------------------------------
+// HALCON -> MATLAB
+
+static mxArray *RunsToMx(HMatlabSession &session, const Hrlregion *region)
+{
+	size_t n = (size_t)region->num;
+	mxArray *A = session.pool.Acquire(mxINT32_CLASS, mxREAL, n, 3);
+	if (A == NULL)
+	{
+		return NULL;
+	}
+	int32_T *v = (int32_T *)mxGetData(A);
+	for (size_t i = 0; i < n; i++)
+	{
+		v[i] = region->rl[i].l;
+		v[n + i] = region->rl[i].cb;
+		v[2 * n + i] = region->rl[i].ce;
+	}
+	return A;
+}
+
+// 直接从行程置位，不经过逐像素的中间图像；超出 height x width 的部分裁掉
+static mxArray *RunsToPacked(HMatlabSession &session, const Hrlregion *region, size_t height, size_t width)
+{
+	size_t words = (height + 31) / 32;
+	mxArray *bits = session.pool.Acquire(mxUINT32_CLASS, mxREAL, words, width);
+	mxArray *size = mxCreateDoubleMatrix(1, 2, mxREAL);
+	const char *fields[2] = {"bits", "size"};
+	mxArray *S = mxCreateStructMatrix(1, 1, 2, fields);
+	if (bits == NULL || size == NULL || S == NULL)
+	{
+		session.pool.Release(bits);
+		session.pool.Release(size);
+		session.pool.Release(S);
+		return NULL;
+	}
+	uint32_T *w = (uint32_T *)mxGetData(bits);
+	memset(w, 0, words * width * sizeof(uint32_T));
+	for (HITEMCNT i = 0; i < region->num; i++)
+	{
+		const Hrun &run = region->rl[i];
+		if (run.l < 0 || (size_t)run.l >= height)
+		{
+			continue;
+		}
+		Hlong cb = std::max<Hlong>(run.cb, 0);
+		Hlong ce = std::min<Hlong>(run.ce, (Hlong)width - 1);
+		uint32_T mask = (uint32_T)1 << (run.l % 32);
+		uint32_T *col = w + run.l / 32;
+		for (Hlong c = cb; c <= ce; c++)
+		{
+			col[(size_t)c * words] |= mask;
+		}
+	}
+	mxGetPr(size)[0] = (double)height;
+	mxGetPr(size)[1] = (double)width;
+	mxSetFieldByNumber(S, 0, 0, bits);
+	mxSetFieldByNumber(S, 0, 1, size);
+	return S;
+}
+
+static mxArray *RunsToLogical(const Hrlregion *region, size_t height, size_t width)
+{
+	mxArray *A = mxCreateLogicalMatrix(height, width);
+	if (A == NULL)
+	{
+		return NULL;
+	}
+	mxLogical *v = mxGetLogicals(A);
+	for (HITEMCNT i = 0; i < region->num; i++)
+	{
+		const Hrun &run = region->rl[i];
+		if (run.l < 0 || (size_t)run.l >= height)
+		{
+			continue;
+		}
+		Hlong cb = std::max<Hlong>(run.cb, 0);
+		Hlong ce = std::min<Hlong>(run.ce, (Hlong)width - 1);
+		for (Hlong c = cb; c <= ce; c++)
+		{
+			v[(size_t)c * height + run.l] = 1;
+		}
+	}
+	return A;
+}
+
+// 结构体里装的是池里的 bits，归还前先摘下来
+static void ReleaseRegionMx(HMatlabSession &session, mxArray *A)
+{
+	if (A != NULL && mxIsStruct(A))
+	{
+		session.pool.Release(mxGetFieldByNumber(A, 0, 0));
+		mxSetFieldByNumber(A, 0, 0, NULL);
+	}
+	session.pool.Release(A);
+}
+
+Herror HMatlab_engPutRegion(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_gen_name, num_gen_value;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 2, &GenParamName, &num_gen_name);
+	HGetPPar(proc_handle, 3, &GenParamValue, &num_gen_value);
+	if (num_gen_name != num_gen_value)
+	{
+		return H_ERR_WIPN3;
+	}
+	HMatlabRegionFormat format = HMatlabRegionRuns;
+	Hlong width = -1, height = -1;
+	for (INT4_8 i = 0; i < num_gen_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT2;
+		}
+		std::string name = GenParamName[i].par.s;
+		if (name == "format")
+		{
+			std::string value = HMatlabParString(GenParamValue[i]);
+			if (value == "runs")
+			{
+				format = HMatlabRegionRuns;
+			}
+			else if (value == "packed")
+			{
+				format = HMatlabRegionPacked;
+			}
+			else if (value == "logical")
+			{
+				format = HMatlabRegionLogical;
+			}
+			else
+			{
+				return H_ERR_WIPV3;
+			}
+		}
+		else if (name == "width" || name == "height")
+		{
+			double value = HMatlabParDouble(GenParamValue[i]);
+			if (value < 1)
+			{
+				return H_ERR_WIPV3;
+			}
+			(name == "width" ? width : height) = (Hlong)value;
+		}
+		else
+		{
+			return H_ERR_WIPV2;
+		}
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	INT4_8 num_obj;
+	HCkP(HGetObjNum(proc_handle, 1, &num_obj));
+	std::vector<Hrlregion *> regions((size_t)num_obj);
+	Hlong max_row = -1, max_col = -1;
+	for (INT4_8 k = 0; k < num_obj; k++)
+	{
+		Hkey key;
+		HCkP(HGetObj(proc_handle, 1, k + 1, &key));
+		HCkP(HGetFDRL(proc_handle, key, &regions[(size_t)k]));
+		const Hrlregion *region = regions[(size_t)k];
+		for (HITEMCNT i = 0; i < region->num; i++)
+		{
+			max_row = std::max<Hlong>(max_row, region->rl[i].l);
+			max_col = std::max<Hlong>(max_col, region->rl[i].ce);
+		}
+	}
+	// 未给尺寸时取所有区域共同的外接范围 (从 0 开始)
+	if (height < 0)
+	{
+		height = max_row + 1;
+	}
+	if (width < 0)
+	{
+		width = max_col + 1;
+	}
+
+	std::vector<mxArray *> values((size_t)num_obj, (mxArray *)NULL);
+	Herror err = H_MSG_TRUE;
+	for (size_t k = 0; err == H_MSG_TRUE && k < values.size(); k++)
+	{
+		switch (format)
+		{
+		case HMatlabRegionRuns:
+			values[k] = RunsToMx(session, regions[k]);
+			break;
+		case HMatlabRegionPacked:
+			values[k] = RunsToPacked(session, regions[k], (size_t)height, (size_t)width);
+			break;
+		case HMatlabRegionLogical:
+			values[k] = RunsToLogical(regions[k], (size_t)height, (size_t)width);
+			break;
+		}
+		if (values[k] == NULL)
+		{
+			err = H_ERR_MEM;
+		}
+	}
+	if (err == H_MSG_TRUE)
+	{
+		int ret;
+		if (values.size() == 1)
+		{
+			ret = HMatlabPutVariable(session, NAME.par.s, values[0]);
+		}
+		else
+		{
+			mxArray *C = mxCreateCellMatrix(1, values.size());
+			for (size_t k = 0; k < values.size(); k++)
+			{
+				mxSetCell(C, k, values[k]);
+			}
+			ret = HMatlabPutVariable(session, NAME.par.s, C);
+			for (size_t k = 0; k < values.size(); k++)
+			{
+				mxSetCell(C, k, NULL);
+			}
+			mxDestroyArray(C);
+		}
+		if (ret != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+	}
+	for (size_t k = 0; k < values.size(); k++)
+	{
+		ReleaseRegionMx(session, values[k]);
+	}
+	return err;
+}
+
+// ---------------------------------------------------------------------------
+// MATLAB -> HALCON
+
+static bool MxToRuns(const mxArray *A, std::vector<HMatlabRun> *runs)
+{
+	if (mxGetNumberOfDimensions(A) != 2 || mxGetN(A) != 3 || mxIsComplex(A) || mxIsSparse(A))
+	{
+		return false;
+	}
+	size_t n = mxGetM(A);
+	runs->resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		Hlong v[3];
+		for (size_t j = 0; j < 3; j++)
+		{
+			if (mxIsInt32(A))
+			{
+				v[j] = ((const int32_T *)mxGetData(A))[j * n + i];
+			}
+			else if (mxIsDouble(A))
+			{
+				v[j] = (Hlong)mxGetPr(A)[j * n + i];
+			}
+			else
+			{
+				return false;
+			}
+		}
+		(*runs)[i].row = v[0];
+		(*runs)[i].cb = v[1];
+		(*runs)[i].ce = v[2];
+	}
+	return true;
+}
+
+// 逐行扫描位图，连续的置位像素合成一个行程；pixel(r, c) 返回该像素是否属于区域
+template <typename Pixel>
+static void ScanRuns(size_t height, size_t width, Pixel pixel, std::vector<HMatlabRun> *runs)
+{
+	runs->clear();
+	for (size_t r = 0; r < height; r++)
+	{
+		size_t c = 0;
+		while (c < width)
+		{
+			while (c < width && !pixel(r, c))
+			{
+				c++;
+			}
+			if (c == width)
+			{
+				break;
+			}
+			HMatlabRun run;
+			run.row = (Hlong)r;
+			run.cb = (Hlong)c;
+			while (c < width && pixel(r, c))
+			{
+				c++;
+			}
+			run.ce = (Hlong)c - 1;
+			runs->push_back(run);
+		}
+	}
+}
+
+static bool PackedToRuns(const mxArray *S, std::vector<HMatlabRun> *runs)
+{
+	const mxArray *bits = mxGetField(S, 0, "bits");
+	const mxArray *size = mxGetField(S, 0, "size");
+	if (bits == NULL || size == NULL || !mxIsUint32(bits) || !mxIsDouble(size) ||
+		mxGetNumberOfElements(size) != 2)
+	{
+		return false;
+	}
+	size_t height = (size_t)mxGetPr(size)[0];
+	size_t width = (size_t)mxGetPr(size)[1];
+	size_t words = (height + 31) / 32;
+	if (mxGetM(bits) != words || mxGetN(bits) != width)
+	{
+		return false;
+	}
+	const uint32_T *w = (const uint32_T *)mxGetData(bits);
+	ScanRuns(height, width, [&](size_t r, size_t c) {
+		return ((w[c * words + r / 32] >> (r % 32)) & 1) != 0;
+	}, runs);
+	return true;
+}
+
+static bool LogicalToRuns(const mxArray *A, std::vector<HMatlabRun> *runs)
+{
+	if (mxGetNumberOfDimensions(A) != 2 || mxIsSparse(A))
+	{
+		return false;
+	}
+	size_t height = mxGetM(A);
+	const mxLogical *v = mxGetLogicals(A);
+	ScanRuns(height, mxGetN(A), [&](size_t r, size_t c) {
+		return v[c * height + r] != 0;
+	}, runs);
+	return true;
+}
+
+static bool MxToRegionRuns(const mxArray *A, std::vector<HMatlabRun> *runs)
+{
+	if (mxIsStruct(A))
+	{
+		return PackedToRuns(A, runs);
+	}
+	if (mxIsLogical(A))
+	{
+		return LogicalToRuns(A, runs);
+	}
+	return MxToRuns(A, runs);
+}
+
+// 按行、起始列排序并合并重叠或相邻的行程，HALCON 要求区域的行程有序且不重叠
+static void NormalizeRuns(std::vector<HMatlabRun> *runs)
+{
+	runs->erase(std::remove_if(runs->begin(), runs->end(),
+							   [](const HMatlabRun &r) { return r.ce < r.cb; }),
+				runs->end());
+	if (!std::is_sorted(runs->begin(), runs->end(), RunLess))
+	{
+		std::sort(runs->begin(), runs->end(), RunLess);
+	}
+	size_t out = 0;
+	for (size_t i = 0; i < runs->size(); i++)
+	{
+		const HMatlabRun &run = (*runs)[i];
+		if (out > 0 && (*runs)[out - 1].row == run.row && (*runs)[out - 1].ce + 1 >= run.cb)
+		{
+			(*runs)[out - 1].ce = std::max((*runs)[out - 1].ce, run.ce);
+		}
+		else
+		{
+			(*runs)[out++] = run;
+		}
+	}
+	runs->resize(out);
+}
+
+static Herror PutRegionRuns(Hproc_handle proc_handle, const std::vector<HMatlabRun> &runs)
+{
+	const Hlong coord_min = sizeof(HIMGCOOR) == 2 ? SHRT_MIN : INT_MIN;
+	const Hlong coord_max = sizeof(HIMGCOOR) == 2 ? SHRT_MAX : INT_MAX;
+	Hrlregion *region;
+	HCkP(HAllocRLNumTmp(proc_handle, &region, runs.size()));
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		const HMatlabRun &run = runs[i];
+		if (run.row < coord_min || run.row > coord_max || run.cb < coord_min || run.ce > coord_max)
+		{
+			HFreeRLTmp(proc_handle, region);
+			return H_ERR_WIPV1; // 坐标超出 HIMGCOOR 的范围
+		}
+		region->rl[i].l = (HIMGCOOR)run.row;
+		region->rl[i].cb = (HIMGCOOR)run.cb;
+		region->rl[i].ce = (HIMGCOOR)run.ce;
+	}
+	region->num = (HITEMCNT)runs.size();
+	region->is_compl = FALSE;
+	Hkey key;
+	Herror err = HPutDRL(proc_handle, UNDEF_KEY, region, &key);
+	HFreeRLTmp(proc_handle, region);
+	return err;
+}
+
+Herror HMatlab_engGetRegion(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	mxArray *A = HMatlabGetVariable(session, NAME.par.s);
+	if (A == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	// 格式由变量本身的类型决定：元胞是多个区域，结构体是 packed，logical 是位图，其余按行程读
+	std::vector<const mxArray *> items;
+	if (mxIsCell(A))
+	{
+		for (size_t k = 0; k < mxGetNumberOfElements(A); k++)
+		{
+			items.push_back(mxGetCell(A, k));
+		}
+	}
+	else
+	{
+		items.push_back(A);
+	}
+	Herror err = H_MSG_TRUE;
+	std::vector<HMatlabRun> runs;
+	for (size_t k = 0; err == H_MSG_TRUE && k < items.size(); k++)
+	{
+		if (items[k] == NULL || !MxToRegionRuns(items[k], &runs))
+		{
+			err = H_ERR_MATLAB_ENGINE;
+			break;
+		}
+		NormalizeRuns(&runs);
+		err = PutRegionRuns(proc_handle, runs);
+	}
+	mxDestroyArray(A);
+	return err;
+}
+
+// ---------------------------------------------------------------------------
+// 字典里的区域：MATLAB 侧统一用外接范围大小的 logical 图像，和 regionprops 等直接配合
+
+Herror HMatlabRegionToMx(Hproc_handle proc_handle, Hkey key, mxArray **out)
+{
+	Hrlregion *region;
+	HCkP(HGetFDRL(proc_handle, key, &region));
+	Hlong max_row = -1, max_col = -1;
+	for (HITEMCNT i = 0; i < region->num; i++)
+	{
+		max_row = std::max<Hlong>(max_row, region->rl[i].l);
+		max_col = std::max<Hlong>(max_col, region->rl[i].ce);
+	}
+	*out = RunsToLogical(region, (size_t)(max_row + 1), (size_t)(max_col + 1));
+	return *out != NULL ? H_MSG_TRUE : H_ERR_MEM;
+}
+
+Herror HMatlabMxToRegionObject(const mxArray *A, HalconCpp::HObject *region)
+{
+	std::vector<HMatlabRun> runs;
+	if (!MxToRegionRuns(A, &runs))
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	NormalizeRuns(&runs);
+	std::vector<Hlong> row(runs.size()), cb(runs.size()), ce(runs.size());
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		row[i] = runs[i].row;
+		cb[i] = runs[i].cb;
+		ce[i] = runs[i].ce;
+	}
+	HalconCpp::GenRegionRuns(region, HalconCpp::HTuple(row.data(), (Hlong)row.size()),
+							 HalconCpp::HTuple(cb.data(), (Hlong)cb.size()),
+							 HalconCpp::HTuple(ce.data(), (Hlong)ce.size()));
+	return H_MSG_TRUE;
+}
@@ -0,0 +1,663 @@
+#include "Halcon_MatlabScheduler.h"
+#include "Halcon_MatlabNamespace.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#define HMatlabGetPid _getpid
+#else
+#include <unistd.h>
+#define HMatlabGetPid getpid
+#endif
+
+typedef std::chrono::steady_clock HMatlabClock;
+
+namespace
+{
+struct Job
+{
+	HMatlabSession *source;
+	const std::vector<std::string> *vars;
+	const std::function<Herror(HMatlabSession &)> *fn;
+	HMatlabPriority priority;
+	std::string ns; // 提交线程的工作区命名空间
+	size_t home;
+	bool pinned; // 变量复制失败，只能在 home 引擎上执行，不再被偷
+	HMatlabClock::time_point submitted;
+	Herror result;
+	std::exception_ptr error;
+	bool done;
+	// HMatlabSchedulePost 提交的任务自己持有参数，结束后由调度线程调用 finish 并释放
+	std::vector<std::string> owned_vars;
+	std::function<Herror(HMatlabSession &)> owned_fn;
+	std::function<void(Herror)> finish;
+};
+
+struct Runner
+{
+	Runner() : alive(true), open(false), busy(false) {}
+	std::deque<Job *> jobs[kHMatlabPriorityCount];
+	bool alive; // 引擎打不开时退出，队列里剩下的任务由别的调度线程偷走
+	bool open;	// 引擎已经打开过 (调度线程记录，引擎被别处关掉时不一定及时)
+	bool busy;	// 正在执行任务
+};
+
+struct State
+{
+	State() : stop(false), alive(0), reserved(0), jobs(0), steals(0), replications(0), wait_ns(0), wait_max_ns(0)
+	{
+		for (int p = 0; p < kHMatlabPriorityCount; p++)
+		{
+			class_jobs[p] = 0;
+			class_wait_ns[p] = 0;
+			class_wait_max_ns[p] = 0;
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable work;
+	std::condition_variable done;
+	std::vector<Job *> finished; // 已经结束、还没回调的异步任务
+	bool stop;
+	std::deque<Runner> runners; // 只增不减，元素地址不变
+	size_t alive;
+	// 序号最大的 reserved 个引擎只执行 high 任务，至少留一个引擎给其他任务
+	size_t reserved;
+
+	// 同一个 MAT 文件的 save 和 load 不能交错。总是先持有会话的 scope 再锁它，不会和 scope 死锁
+	std::mutex replicate;
+	// (会话, 变量) 已经 save 的版本，版本没变时直接 load 上次的文件
+	std::map<std::pair<HMatlabSession *, std::string>, uint64_t> saved;
+	std::vector<std::string> files;
+
+	std::atomic<uint64_t> jobs;
+	std::atomic<uint64_t> steals;
+	std::atomic<uint64_t> replications;
+	std::atomic<uint64_t> wait_ns;
+	std::atomic<uint64_t> wait_max_ns;
+	std::atomic<uint64_t> class_jobs[kHMatlabPriorityCount];
+	std::atomic<uint64_t> class_wait_ns[kHMatlabPriorityCount];
+	std::atomic<uint64_t> class_wait_max_ns[kHMatlabPriorityCount];
+};
+
+// 进程退出时通知调度线程退出后 detach，和 HMatlabWorker 一样不 join
+struct Scheduler
+{
+	Scheduler() : state(new State()) {}
+	~Scheduler()
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->stop = true;
+		state->work.notify_all();
+		for (size_t i = 0; i < state->files.size(); i++)
+		{
+			std::remove(state->files[i].c_str());
+		}
+	}
+	std::shared_ptr<State> state;
+};
+} // namespace
+
+static Scheduler &GetScheduler()
+{
+	static Scheduler scheduler;
+	return scheduler;
+}
+
+static void UpdateMax(std::atomic<uint64_t> &max, uint64_t value)
+{
+	uint64_t old = max.load(std::memory_order_relaxed);
+	while (value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+// MAT 文件放在临时目录，MATLAB 的 tempdir 也取自这些环境变量
+static std::string ReplicaPath(size_t source, const std::string &name)
+{
+	const char *dir = getenv("TEMP");
+	if (dir == NULL)
+	{
+		dir = getenv("TMP");
+	}
+	std::string path = dir != NULL ? dir : "/tmp";
+	char file[96];
+	snprintf(file, sizeof(file), "/hm_rep_%d_%u_", (int)HMatlabGetPid(), (unsigned)source);
+	return path + file + name + ".mat";
+}
+
+// 放进 MATLAB 的单引号字符串
+static std::string Quote(const std::string &path)
+{
+	std::string quoted;
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		quoted += path[i];
+		if (path[i] == '\'')
+		{
+			quoted += '\'';
+		}
+	}
+	return quoted;
+}
+
+// 被偷的任务要用的变量：在提交方的会话里 save 成 MAT 文件 (来源版本没变时沿用上次的文件)。
+// 只持有来源会话的 scope，返回 false 表示有变量没能保存
+static bool SaveReplicas(State &s, const Job &job, std::vector<std::string> *paths)
+{
+	HMatlabSession &source = *job.source;
+	size_t index = HMatlabSessionIndex(source);
+	HMatlabEngineScope scope(source.worker);
+	std::lock_guard<std::mutex> lock(s.replicate);
+	for (size_t i = 0; i < job.vars->size(); i++)
+	{
+		// save 在任务的命名空间里执行；记录和文件名按命名空间区分同名变量
+		const std::string &var = (*job.vars)[i];
+		std::string name = job.ns.empty() ? var : job.ns + "." + var;
+		std::string path = ReplicaPath(index, name);
+		std::pair<HMatlabSession *, std::string> key(&source, name);
+		std::map<std::pair<HMatlabSession *, std::string>, uint64_t>::iterator it = s.saved.find(key);
+		if (it == s.saved.end() || it->second != source.revision)
+		{
+			// 确认 save 执行完才记下版本，否则之后的任务会把旧文件或不存在的文件当成最新的
+			std::string cmd = "save('" + Quote(path) + "','-v7','" + var + "');";
+			if (!HMatlabEvalChecked(source, cmd.c_str()))
+			{
+				s.saved.erase(key);
+				return false;
+			}
+			if (it == s.saved.end())
+			{
+				s.files.push_back(path);
+			}
+			s.saved[key] = source.revision;
+		}
+		paths->push_back(path);
+	}
+	return true;
+}
+
+// 在目标引擎上 load 变量。目标工作区 (或同一命名空间) 里原有的同名变量先存进 hm_rep_keep__，
+// 没有的记进 hm_rep_new__，任务执行完由 RestoreReplicas 还原，绑定在这个引擎上的线程的变量
+// 不会被覆盖。调用方持有目标会话的 scope；返回 false 时也要调用 RestoreReplicas
+static bool LoadReplicas(State &s, HMatlabSession &target, const Job &job, const std::vector<std::string> &paths)
+{
+	std::string cmd = "hm_rep_keep__=struct();hm_rep_new__={};";
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		const std::string &var = (*job.vars)[i];
+		cmd += "if exist('" + var + "','var')==1,hm_rep_keep__." + var + "=" + var + ";else,hm_rep_new__{end+1}='" +
+			   var + "';end;hm_rep__=load('" + Quote(paths[i]) + "','" + var + "');" + var + "=hm_rep__." + var + ";";
+	}
+	std::lock_guard<std::mutex> lock(s.replicate);
+	return HMatlabEvalChecked(target, cmd.c_str());
+}
+
+static bool RestoreReplicas(HMatlabSession &target, const Job &job)
+{
+	std::string cmd;
+	for (size_t i = 0; i < job.vars->size(); i++)
+	{
+		const std::string &var = (*job.vars)[i];
+		cmd += "if isfield(hm_rep_keep__,'" + var + "')," + var + "=hm_rep_keep__." + var +
+			   ";elseif any(strcmp(hm_rep_new__,'" + var + "')),clear " + var + ";end;";
+	}
+	bool ok = HMatlabEvalChecked(target, cmd.c_str());
+	HMatlabClearLater(target, "hm_rep_keep__");
+	HMatlabClearLater(target, "hm_rep_new__");
+	HMatlabClearLater(target, "hm_rep__");
+	return ok;
+}
+
+// 任务结束。同步提交的任务唤醒在 s.done 上等待的提交线程，异步提交的任务等调度线程解锁后
+// 回调 (见 RunFinished)。调用方持有 s.mutex
+static void Complete(State &s, Job *job)
+{
+	job->done = true;
+	if (job->finish)
+	{
+		s.finished.push_back(job);
+	}
+	s.done.notify_all();
+}
+
+// 在锁外回调已经结束的异步任务并释放它们，lock 锁的是 s.mutex
+static void RunFinished(State &s, std::unique_lock<std::mutex> &lock)
+{
+	while (!s.finished.empty())
+	{
+		std::vector<Job *> jobs;
+		jobs.swap(s.finished);
+		lock.unlock();
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			try
+			{
+				jobs[i]->finish(jobs[i]->error ? (Herror)H_ERR_MATLAB_ENGINE : jobs[i]->result);
+			}
+			catch (...)
+			{
+			}
+			delete jobs[i];
+		}
+		lock.lock();
+	}
+}
+
+// 复制失败的任务放回 home 引擎的队头，只由 home 执行；home 已经退出时直接失败。调用方持有 s.mutex
+static void PinHome(State &s, Job *job)
+{
+	job->pinned = true;
+	if (!s.runners[job->home].alive)
+	{
+		job->result = H_ERR_MATLAB_ENGINE;
+		Complete(s, job);
+		return;
+	}
+	s.runners[job->home].jobs[job->priority].push_front(job);
+	s.work.notify_all();
+}
+
+// 调度线程退出时，队列里只能在它上面执行的任务直接失败，其余的留给别的调度线程偷。
+// 最后一个调度线程退出时异步提交的任务也都失败 (同步提交的由提交线程自己从队列里删掉)。
+// 调用方持有 s.mutex
+static void Retire(State &s, size_t self)
+{
+	s.runners[self].alive = false;
+	s.alive--;
+	for (size_t r = 0; r < s.runners.size(); r++)
+	{
+		for (int p = 0; p < kHMatlabPriorityCount; p++)
+		{
+			std::deque<Job *> &jobs = s.runners[r].jobs[p];
+			for (std::deque<Job *>::iterator it = jobs.begin(); it != jobs.end();)
+			{
+				Job *job = *it;
+				if ((r == self && job->pinned) || (s.alive == 0 && job->finish))
+				{
+					job->result = H_ERR_MATLAB_ENGINE;
+					Complete(s, job);
+					it = jobs.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+	}
+	s.work.notify_all();
+	s.done.notify_all();
+}
+
+// 保留给 high 的引擎只取 high 任务
+static int Classes(const State &s, size_t self)
+{
+	size_t reserved = (std::min)(s.reserved, s.runners.size() - 1);
+	return self >= s.runners.size() - reserved ? 1 : kHMatlabPriorityCount;
+}
+
+// 有没有已经打开、空闲、能执行第 p 级任务的别的引擎
+static bool OpenIdle(const State &s, size_t self, int p)
+{
+	for (size_t r = 0; r < s.runners.size(); r++)
+	{
+		const Runner &runner = s.runners[r];
+		if (r != self && runner.alive && runner.open && !runner.busy && p < Classes(s, r))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// 按优先级从高到低找：自己的队列从队头取，偷别人的从队尾取，从下一个引擎开始轮流找。
+// 引擎还没打开的调度线程只在打开的引擎都忙时才偷，引擎按需打开。复制失败的任务不偷
+static Job *Take(State &s, size_t self, bool *stolen)
+{
+	int classes = Classes(s, self);
+	for (int p = 0; p < classes; p++)
+	{
+		std::deque<Job *> &own = s.runners[self].jobs[p];
+		if (!own.empty())
+		{
+			Job *job = own.front();
+			own.pop_front();
+			*stolen = false;
+			return job;
+		}
+		if (!s.runners[self].open && OpenIdle(s, self, p))
+		{
+			continue;
+		}
+		for (size_t k = 1; k < s.runners.size(); k++)
+		{
+			std::deque<Job *> &other = s.runners[(self + k) % s.runners.size()].jobs[p];
+			for (std::deque<Job *>::reverse_iterator it = other.rbegin(); it != other.rend(); ++it)
+			{
+				if (!(*it)->pinned)
+				{
+					Job *job = *it;
+					other.erase(std::next(it).base());
+					*stolen = true;
+					return job;
+				}
+			}
+		}
+	}
+	// 保留给 high 的引擎也执行自己队列里复制失败的任务：它们只能在这个引擎上执行
+	for (int p = classes; p < kHMatlabPriorityCount; p++)
+	{
+		std::deque<Job *> &own = s.runners[self].jobs[p];
+		for (std::deque<Job *>::iterator it = own.begin(); it != own.end(); ++it)
+		{
+			if ((*it)->pinned)
+			{
+				Job *job = *it;
+				own.erase(it);
+				*stolen = false;
+				return job;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void Loop(std::shared_ptr<State> state, size_t self)
+{
+	State &s = *state;
+	HMatlabSession &session = HMatlabPoolSession(self);
+	std::unique_lock<std::mutex> lock(s.mutex);
+	while (true)
+	{
+		RunFinished(s, lock);
+		Job *job = NULL;
+		bool stolen = false;
+		s.work.wait(lock, [&]() { return s.stop || (job = Take(s, self, &stolen)) != NULL; });
+		if (job == NULL)
+		{
+			return;
+		}
+		s.runners[self].busy = true;
+		lock.unlock();
+
+		// 第一次拿到任务时才打开引擎 (池里的引擎也可能已被 Matlab_engClose 关掉)。
+		// 打不开就退出，任务放回队列由别的调度线程执行
+		bool open;
+		{
+			HMatlabEngineScope scope(session.worker);
+			open = session.ep != NULL || HMatlabOpenEngine(session);
+		}
+		if (!open)
+		{
+			lock.lock();
+			s.runners[self].busy = false;
+			s.runners[self].jobs[job->priority].push_back(job);
+			Retire(s, self);
+			RunFinished(s, lock);
+			return;
+		}
+
+		uint64_t wait = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			HMatlabClock::now() - job->submitted).count();
+		bool replicate = job->source != &session && !job->vars->empty();
+		bool replicated = true;
+		try
+		{
+			// 调度线程替提交方排队，在引擎上也按任务的优先级
+			HMatlabPriorityGuard priority(job->priority);
+			HMatlabNamespaceGuard ns(job->ns);
+			std::vector<std::string> paths;
+			replicated = !replicate || SaveReplicas(s, *job, &paths);
+			if (replicated)
+			{
+				// 复制、执行、还原在同一个 scope 里，中间不会插进绑定在这个引擎上的线程
+				HMatlabCallScope scope(session);
+				replicated = !replicate || LoadReplicas(s, session, *job, paths);
+				try
+				{
+					if (replicated)
+					{
+						job->result = (*job->fn)(session);
+					}
+				}
+				catch (...)
+				{
+					job->error = std::current_exception();
+				}
+				if (replicate && !RestoreReplicas(session, *job) && replicated && job->result == H_MSG_TRUE)
+				{
+					job->result = H_ERR_MATLAB_ENGINE;
+				}
+			}
+		}
+		catch (...)
+		{
+			job->error = std::current_exception();
+		}
+
+		lock.lock();
+		s.runners[self].open = true;
+		s.runners[self].busy = false;
+		if (!replicated && !job->error)
+		{
+			// 变量没复制过去，任务没有执行，改回提交方自己的引擎上执行
+			PinHome(s, job);
+			continue;
+		}
+		s.jobs.fetch_add(1, std::memory_order_relaxed);
+		s.wait_ns.fetch_add(wait, std::memory_order_relaxed);
+		UpdateMax(s.wait_max_ns, wait);
+		s.class_jobs[job->priority].fetch_add(1, std::memory_order_relaxed);
+		s.class_wait_ns[job->priority].fetch_add(wait, std::memory_order_relaxed);
+		UpdateMax(s.class_wait_max_ns[job->priority], wait);
+		if (stolen)
+		{
+			s.steals.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (replicate)
+		{
+			s.replications.fetch_add(1, std::memory_order_relaxed);
+		}
+		Complete(s, job);
+		// 打开了引擎，之前因为有空闲的打开引擎而没偷的任务可能还在等
+		s.work.notify_all();
+	}
+}
+
+static bool CheckVars(const std::vector<std::string> &vars)
+{
+	for (size_t i = 0; i < vars.size(); i++)
+	{
+		if (!HMatlabIsVarName(vars[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void InitJob(Job *job, HMatlabSession &source)
+{
+	job->source = &source;
+	job->priority = HMatlabThreadPriority();
+	job->ns = HMatlabThreadNamespace();
+	job->home = HMatlabSessionIndex(source);
+	job->pinned = false;
+	job->result = H_MSG_TRUE;
+	job->done = false;
+}
+
+// 把任务放进提交方的队列，没有可用引擎时返回 false。调用方持有 s.mutex
+static bool Enqueue(Scheduler &scheduler, Job *job)
+{
+	State &s = *scheduler.state;
+	// 池调大以后补上新的调度线程。调度线程拿到任务时才打开各自的引擎
+	size_t count = (std::max)(HMatlabEnginePoolSize(), job->home + 1);
+	while (s.runners.size() < count)
+	{
+		s.runners.push_back(Runner());
+		s.alive++;
+		std::thread(Loop, scheduler.state, s.runners.size() - 1).detach();
+	}
+	if (s.alive == 0)
+	{
+		return false;
+	}
+	// 提交方的引擎是开着的，它的调度线程空闲时别的引擎不必为这个任务打开
+	s.runners[job->home].open = true;
+	job->submitted = HMatlabClock::now();
+	s.runners[job->home].jobs[job->priority].push_back(job);
+	s.work.notify_all();
+	return true;
+}
+
+Herror HMatlabSchedule(HMatlabSession &source, const std::vector<std::string> &vars,
+					   const std::function<Herror(HMatlabSession &)> &fn)
+{
+	if (!CheckVars(vars))
+	{
+		return H_ERR_WIPV6;
+	}
+	Scheduler &scheduler = GetScheduler();
+	State &s = *scheduler.state;
+	Job job;
+	InitJob(&job, source);
+	job.vars = &vars;
+	job.fn = &fn;
+
+	std::unique_lock<std::mutex> lock(s.mutex);
+	if (!Enqueue(scheduler, &job))
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	s.done.wait(lock, [&]() { return job.done || s.alive == 0; });
+	if (!job.done)
+	{
+		// 所有引擎都打不开，任务还在某个队列里 (打不开的调度线程把任务放回自己的队列)
+		for (size_t r = 0; r < s.runners.size(); r++)
+		{
+			std::deque<Job *> &jobs = s.runners[r].jobs[job.priority];
+			jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+		}
+		return H_ERR_MATLAB_ENGINE;
+	}
+	lock.unlock();
+	if (job.error)
+	{
+		std::rethrow_exception(job.error);
+	}
+	return job.result;
+}
+
+void HMatlabSchedulePost(HMatlabSession &source, const std::vector<std::string> &vars,
+						 const std::function<Herror(HMatlabSession &)> &fn, const std::function<void(Herror)> &finish)
+{
+	if (!CheckVars(vars))
+	{
+		finish(H_ERR_WIPV6);
+		return;
+	}
+	Scheduler &scheduler = GetScheduler();
+	State &s = *scheduler.state;
+	Job *job = new Job();
+	InitJob(job, source);
+	job->owned_vars = vars;
+	job->owned_fn = fn;
+	job->vars = &job->owned_vars;
+	job->fn = &job->owned_fn;
+	job->finish = finish;
+	bool queued;
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		queued = Enqueue(scheduler, job);
+	}
+	if (!queued)
+	{
+		delete job;
+		finish(H_ERR_MATLAB_ENGINE);
+	}
+}
+
+uint64_t HMatlabSchedulerJobs()
+{
+	return GetScheduler().state->jobs.load();
+}
+
+uint64_t HMatlabSchedulerSteals()
+{
+	return GetScheduler().state->steals.load();
+}
+
+uint64_t HMatlabSchedulerReplications()
+{
+	return GetScheduler().state->replications.load();
+}
+
+uint64_t HMatlabSchedulerWaitUs()
+{
+	return GetScheduler().state->wait_ns.load() / 1000;
+}
+
+uint64_t HMatlabSchedulerWaitMaxUs()
+{
+	return GetScheduler().state->wait_max_ns.load() / 1000;
+}
+
+uint64_t HMatlabSchedulerJobs(HMatlabPriority priority)
+{
+	return GetScheduler().state->class_jobs[priority].load();
+}
+
+uint64_t HMatlabSchedulerWaitUs(HMatlabPriority priority)
+{
+	return GetScheduler().state->class_wait_ns[priority].load() / 1000;
+}
+
+uint64_t HMatlabSchedulerWaitMaxUs(HMatlabPriority priority)
+{
+	return GetScheduler().state->class_wait_max_ns[priority].load() / 1000;
+}
+
+void HMatlabSchedulerSetReserved(size_t engines)
+{
+	State &s = *GetScheduler().state;
+	std::lock_guard<std::mutex> lock(s.mutex);
+	s.reserved = engines;
+	s.work.notify_all();
+}
+
+size_t HMatlabSchedulerReserved()
+{
+	State &s = *GetScheduler().state;
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.reserved;
+}
+
+void HMatlabSchedulerResetStats()
+{
+	State &s = *GetScheduler().state;
+	s.jobs.store(0);
+	s.steals.store(0);
+	s.replications.store(0);
+	s.wait_ns.store(0);
+	s.wait_max_ns.store(0);
+	for (int p = 0; p < kHMatlabPriorityCount; p++)
+	{
+		s.class_jobs[p].store(0);
+		s.class_wait_ns[p].store(0);
+		s.class_wait_max_ns[p].store(0);
+	}
+}
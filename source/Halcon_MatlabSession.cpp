@@ -0,0 +1,685 @@
+﻿#include "Halcon_MatlabSession.h"
+#include "Halcon_MatlabCpu.h"
+#include "Halcon_MatlabDeadline.h"
+#include "Halcon_MatlabNamespace.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+// 会话池：sessions[0] 是默认会话。会话只增不删，指针一直有效
+struct HMatlabSessionPool
+{
+	HMatlabSessionPool() : per_thread(false), max_sessions(4), generation(0), shared_binds(0)
+	{
+		sessions.push_back(std::unique_ptr<HMatlabSession>(new HMatlabSession()));
+		binds.push_back(0);
+		fallback = sessions[0].get();
+	}
+
+	std::mutex mutex;
+	std::atomic<bool> per_thread;
+	HMatlabSession *fallback; // 默认会话，不加锁读取
+	size_t max_sessions;
+	std::vector<std::unique_ptr<HMatlabSession> > sessions;
+	std::vector<size_t> binds; // 每个会话绑定的线程数
+	// 切换亲和模式时加一，旧的线程绑定随之失效
+	uint64_t generation;
+	uint64_t shared_binds;
+};
+
+static HMatlabSessionPool &SessionPool()
+{
+	static HMatlabSessionPool pool;
+	return pool;
+}
+
+// 线程退出时归还绑定
+struct HMatlabBinding
+{
+	HMatlabBinding() : session(NULL), index(0), generation(0) {}
+	~HMatlabBinding()
+	{
+		if (session == NULL)
+		{
+			return;
+		}
+		HMatlabSessionPool &pool = SessionPool();
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if (generation == pool.generation && pool.binds[index] > 0)
+		{
+			pool.binds[index]--;
+		}
+	}
+
+	HMatlabSession *session;
+	size_t index;
+	uint64_t generation;
+};
+
+static thread_local HMatlabBinding tls_binding;
+
+// 新建的会话沿用默认会话的设置
+static void CopySettings(HMatlabSession &from, HMatlabSession &to)
+{
+	HMatlabEngineScope scope(from.worker);
+	to.deferred = from.deferred;
+	to.batch_max = from.batch_max;
+	to.put_batch_max_member_bytes = from.put_batch_max_member_bytes;
+	to.put_int64 = from.put_int64;
+	to.chunk_bytes = from.chunk_bytes;
+	to.pool.SetMaxBytes(from.pool.MaxBytes());
+	to.promoter.SetThreshold(from.promoter.Threshold());
+	to.comp_threads.store(from.comp_threads.load());
+	to.profile = from.profile;
+	to.startcmd = from.startcmd;
+	to.single_thread = from.single_thread;
+	to.auto_clear = from.auto_clear;
+	to.transient = from.transient;
+	to.soft_limit = from.soft_limit;
+	to.hard_limit = from.hard_limit;
+	to.check_interval = from.check_interval;
+}
+
+HMatlabSession &HMatlabGetSession()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	if (!pool.per_thread.load())
+	{
+		return *pool.fallback;
+	}
+	HMatlabBinding &binding = tls_binding;
+	HMatlabSession *session = NULL;
+	bool created = false;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if (binding.session != NULL && binding.generation == pool.generation)
+		{
+			return *binding.session;
+		}
+		size_t index = pool.sessions.size();
+		for (size_t i = 0; i < pool.sessions.size(); i++)
+		{
+			if (pool.binds[i] == 0)
+			{
+				index = i;
+				break;
+			}
+		}
+		if (index == pool.sessions.size())
+		{
+			if (pool.sessions.size() < pool.max_sessions)
+			{
+				pool.sessions.push_back(std::unique_ptr<HMatlabSession>(new HMatlabSession()));
+				pool.binds.push_back(0);
+				created = true;
+			}
+			else
+			{
+				index = (size_t)(std::min_element(pool.binds.begin(), pool.binds.end()) - pool.binds.begin());
+				pool.shared_binds++;
+			}
+		}
+		pool.binds[index]++;
+		session = pool.sessions[index].get();
+		binding.session = session;
+		binding.index = index;
+		binding.generation = pool.generation;
+	}
+	if (created)
+	{
+		CopySettings(*pool.fallback, *session);
+	}
+	// 第一次绑定时打开引擎，可能要几秒；同一会话上的其他线程在 scope 上排队
+	HMatlabEngineScope scope(session->worker);
+	if (session->ep == NULL)
+	{
+		HMatlabOpenEngine(*session);
+	}
+	return *session;
+}
+
+HMatlabSession &HMatlabPoolSession(size_t index)
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::vector<HMatlabSession *> created;
+	HMatlabSession *session = NULL;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		while (pool.sessions.size() <= index)
+		{
+			pool.sessions.push_back(std::unique_ptr<HMatlabSession>(new HMatlabSession()));
+			pool.binds.push_back(0);
+			created.push_back(pool.sessions.back().get());
+		}
+		session = pool.sessions[index].get();
+	}
+	for (size_t i = 0; i < created.size(); i++)
+	{
+		CopySettings(*pool.fallback, *created[i]);
+	}
+	return *session;
+}
+
+void HMatlabSetThreadAffinity(bool per_thread)
+{
+	HMatlabSessionPool &pool = SessionPool();
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if (pool.per_thread.load() == per_thread)
+		{
+			return;
+		}
+		pool.generation++;
+		std::fill(pool.binds.begin(), pool.binds.end(), 0);
+		pool.per_thread.store(per_thread);
+	}
+	if (!per_thread)
+	{
+		HMatlabClosePooledEngines();
+	}
+}
+
+bool HMatlabThreadAffinity()
+{
+	return SessionPool().per_thread.load();
+}
+
+void HMatlabSetEnginePoolSize(size_t size)
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	pool.max_sessions = (std::max)(size, (size_t)1);
+}
+
+size_t HMatlabEnginePoolSize()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	return pool.max_sessions;
+}
+
+size_t HMatlabEngineCount()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	size_t count = 0;
+	for (size_t i = 0; i < pool.sessions.size(); i++)
+	{
+		count += pool.sessions[i]->ep != NULL;
+	}
+	return count;
+}
+
+size_t HMatlabSessionIndex(const HMatlabSession &session)
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	for (size_t i = 0; i < pool.sessions.size(); i++)
+	{
+		if (pool.sessions[i].get() == &session)
+		{
+			return i;
+		}
+	}
+	return 0;
+}
+
+uint64_t HMatlabSharedBinds()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	return pool.shared_binds;
+}
+
+static const struct
+{
+	const char *name;
+	const char *options;
+	bool single_thread;
+} kProfiles[] = {
+	{"desktop", "", false},
+	{"nodesktop", "-nodesktop -nosplash", false},
+	{"compute", "-nodesktop -nosplash -nodisplay -nojvm", false},
+	{"single", "-nodesktop -nosplash -nodisplay -nojvm -singleCompThread", true},
+};
+
+bool HMatlabIsStartupProfile(const std::string &profile)
+{
+#ifdef _WIN32
+	// Windows 上 engOpen 通过 COM 启动 MATLAB，忽略启动命令，其他配置都和 desktop 一样
+	if (profile != "desktop")
+	{
+		return false;
+	}
+#endif
+	for (size_t i = 0; i < sizeof(kProfiles) / sizeof(kProfiles[0]); i++)
+	{
+		if (profile == kProfiles[i].name)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HMatlabSetStartup(HMatlabSession &session, const std::string &profile, const std::string &options,
+					   const std::string &command)
+{
+#ifdef _WIN32
+	if (!HMatlabIsStartupProfile(profile) || !options.empty() || command != "matlab")
+	{
+		return false;
+	}
+#endif
+	for (size_t i = 0; i < sizeof(kProfiles) / sizeof(kProfiles[0]); i++)
+	{
+		if (profile != kProfiles[i].name)
+		{
+			continue;
+		}
+		std::string args = kProfiles[i].options;
+		if (!options.empty())
+		{
+			args += (args.empty() ? "" : " ") + options;
+		}
+		session.profile = profile;
+		session.single_thread = kProfiles[i].single_thread;
+		// 没有任何选项时仍然传 NULL，和以前的 engOpen(NULL) 完全一样
+		session.startcmd = args.empty() && command == "matlab" ? std::string() : command + " " + args;
+		return true;
+	}
+	return false;
+}
+
+bool HMatlabOpenEngine(HMatlabSession &session)
+{
+	bool pooled = &session != SessionPool().fallback;
+	uint64_t start = HMatlabClockUs();
+	session.worker.Run([&]() {
+#ifdef _WIN32
+		// Windows 上 engOpen 连接的是共享的 MATLAB 自动化服务器，池里的会话会落到同一个
+		// 进程上；池里的会话用 engOpenSingleUse 各自启动一个 MATLAB。startcmd 在 Windows 上无效
+		if (pooled)
+		{
+			int status = 0;
+			session.ep = engOpenSingleUse(NULL, NULL, &status);
+			return;
+		}
+		session.ep = engOpen(NULL);
+#else
+		(void)pooled;
+		session.ep = engOpen(session.startcmd.empty() ? NULL : session.startcmd.c_str());
+#endif
+	});
+	if (session.ep == NULL)
+	{
+		return false;
+	}
+	session.startup_us = HMatlabClockUs() - start;
+	HMatlabApplyCpuSettings(session);
+	return true;
+}
+
+bool HMatlabApplyCpuSettings(HMatlabSession &session)
+{
+	if (session.ep == NULL)
+	{
+		return false;
+	}
+	bool ok = true;
+	int threads = session.comp_threads.load();
+	if (threads >= 0)
+	{
+		// maxNumCompThreads(N) 会给出过时警告，但仍然有效
+		std::string cmd = threads == 0 ? "maxNumCompThreads('automatic');"
+									   : "maxNumCompThreads(" + std::to_string(threads) + ");";
+		ok = HMatlabEvalNow(session, ("warning('off','MATLAB:maxNumCompThreads:Deprecated');" + cmd).c_str()) == 0;
+	}
+	uint64_t mask = session.core_mask.load();
+	if (mask != 0)
+	{
+		ok = HMatlabSetProcessCores(HMatlabEnginePid(session), mask) && ok;
+	}
+	return ok;
+}
+
+int64_t HMatlabEnginePid(HMatlabSession &session)
+{
+	if (session.pid != 0)
+	{
+		return session.pid;
+	}
+	HMatlabNamespaceGuard base("");
+	if (HMatlabEvalNow(session, "hm_pid__=feature('getpid');") != 0)
+	{
+		return 0;
+	}
+	mxArray *A = HMatlabGetVariable(session, "hm_pid__");
+	HMatlabClearLater(session, "hm_pid__");
+	int64_t pid = A != NULL && mxIsNumeric(A) && mxGetNumberOfElements(A) == 1 ? (int64_t)mxGetScalar(A) : 0;
+	if (A != NULL)
+	{
+		mxDestroyArray(A);
+	}
+	session.pid = pid;
+	return pid;
+}
+
+size_t HMatlabRecommendedThreadNum()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	uint64_t pinned = 0;
+	size_t limited = 0;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		for (size_t i = 0; i < pool.sessions.size(); i++)
+		{
+			HMatlabSession &session = *pool.sessions[i];
+			if (session.ep == NULL)
+			{
+				continue;
+			}
+			uint64_t mask = session.core_mask.load();
+			int threads = session.comp_threads.load();
+			if (mask != 0)
+			{
+				pinned |= mask;
+			}
+			else if (threads > 0)
+			{
+				limited += (size_t)threads;
+			}
+		}
+	}
+	size_t cores = HMatlabLogicalCores();
+	size_t reserved = HMatlabCoreCount(pinned) + limited;
+	return reserved < cores ? cores - reserved : 1;
+}
+
+void HMatlabCloseEngine(HMatlabSession &session)
+{
+	HMatlabFlush(session);
+	if (session.ep != NULL)
+	{
+		session.worker.Run([&]() { engClose(session.ep); });
+	}
+	session.ep = NULL;
+	session.pool.Clear();
+	session.promoter.Reset();
+	session.image_rois.clear();
+	session.image_tiles.clear();
+	session.namespace_path = false;
+	session.pid = 0;
+	session.tracked.clear();
+}
+
+void HMatlabClosePooledEngines()
+{
+	HMatlabSessionPool &pool = SessionPool();
+	std::vector<HMatlabSession *> sessions;
+	{
+		// 绑定一并作废，之后再用的线程重新绑定并打开引擎
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.generation++;
+		std::fill(pool.binds.begin(), pool.binds.end(), 0);
+		for (size_t i = 1; i < pool.sessions.size(); i++)
+		{
+			sessions.push_back(pool.sessions[i].get());
+		}
+	}
+	for (size_t i = 0; i < sessions.size(); i++)
+	{
+		HMatlabEngineScope scope(sessions[i]->worker);
+		HMatlabCloseEngine(*sessions[i]);
+	}
+}
+
+// engEvalString 在会话的工作线程上执行
+static int HMatlabEngEval(HMatlabSession &session, const std::string &cmd)
+{
+	int ret = 1;
+	session.worker.Run([&]() { ret = engEvalString(session.ep, cmd.c_str()); });
+	return ret;
+}
+
+// 把待清理的临时变量拼成一条 clear 放在 cmd 前面
+static std::string WithCleanup(HMatlabSession &session, const char *cmd)
+{
+	if (session.cleanup.empty())
+	{
+		return cmd;
+	}
+	std::string text = "clear";
+	for (size_t i = 0; i < session.cleanup.size(); i++)
+	{
+		text += " " + session.cleanup[i];
+	}
+	session.cleanup.clear();
+	return text + ";\n" + cmd;
+}
+
+// 内部临时变量 hm_*__ 不计入工作区版本
+static bool IsInternal(const char *name)
+{
+	size_t len = strlen(name);
+	return len > 5 && strncmp(name, "hm_", 3) == 0 && strcmp(name + len - 2, "__") == 0;
+}
+
+// 调用线程有命名空间时改写成 hm_ns_exec__ 调用。临时变量的 clear 加在改写后的语句
+// 前面，在基本工作区里执行
+static bool InNamespace(HMatlabSession &session, const char *cmd, std::string *text)
+{
+	const std::string &id = HMatlabThreadNamespace();
+	if (id.empty())
+	{
+		*text = cmd;
+		return true;
+	}
+	*text = HMatlabNamespaceWrap(id, cmd, &session.namespace_path);
+	return !text->empty();
+}
+
+int HMatlabEval(HMatlabSession &session, const char *cmd)
+{
+	session.revision++;
+	size_t label = session.eval_label;
+	session.eval_label = 0;
+	std::string text;
+	if (!InNamespace(session, cmd, &text))
+	{
+		return 1;
+	}
+	if (!session.deferred)
+	{
+		return HMatlabEngEval(session, WithCleanup(session, text.c_str()));
+	}
+	// 之前登记的临时变量随这条语句一起清理；之后登记的在整批末尾清理
+	session.pending.push_back(WithCleanup(session, text.c_str()));
+	session.pending_label.push_back(label);
+	if (session.pending.size() >= session.batch_max)
+	{
+		return HMatlabFlush(session);
+	}
+	return 0;
+}
+
+int HMatlabEvalNow(HMatlabSession &session, const char *cmd)
+{
+	int ret = HMatlabFlush(session);
+	if (ret != 0)
+	{
+		return ret;
+	}
+	std::string text;
+	if (!InNamespace(session, cmd, &text))
+	{
+		return 1;
+	}
+	return HMatlabEngEval(session, WithCleanup(session, text.c_str()));
+}
+
+bool HMatlabEvalChecked(HMatlabSession &session, const char *cmd)
+{
+	std::string text = std::string("hm_ok__=false;try\n") + cmd + "\nhm_ok__=true;\ncatch\nend";
+	if (HMatlabEvalNow(session, text.c_str()) != 0)
+	{
+		return false;
+	}
+	// 命名空间里执行时 hm_ok__ 由 hm_ns_exec__ 写回基本工作区
+	mxArray *A = HMatlabGetVariable(session, "hm_ok__");
+	HMatlabClearLater(session, "hm_ok__");
+	bool ok = A != NULL && mxIsLogicalScalarTrue(A);
+	if (A != NULL)
+	{
+		mxDestroyArray(A);
+	}
+	return ok;
+}
+
+void HMatlabClearLater(HMatlabSession &session, const char *name)
+{
+	if (std::find(session.cleanup.begin(), session.cleanup.end(), name) == session.cleanup.end())
+	{
+		session.cleanup.push_back(name);
+	}
+}
+
+int HMatlabPutVariable(HMatlabSession &session, const char *name, const mxArray *A)
+{
+	int ret = HMatlabFlush(session);
+	if (ret != 0)
+	{
+		return ret;
+	}
+	session.cleanup.erase(std::remove(session.cleanup.begin(), session.cleanup.end(), name),
+						  session.cleanup.end());
+	if (IsInternal(name))
+	{
+		int result = 1;
+		session.worker.Run([&]() { result = engPutVariable(session.ep, name, A); });
+		return result;
+	}
+	session.revision++;
+	HMatlabNoteWrite(session, name, HMatlabMxBytes(A));
+	const std::string &id = HMatlabThreadNamespace();
+	if (id.empty())
+	{
+		int result = 1;
+		session.worker.Run([&]() { result = engPutVariable(session.ep, name, A); });
+		return result;
+	}
+	// 命名空间里的变量：先传成临时变量，再赋给结构体的字段
+	session.cleanup.erase(std::remove(session.cleanup.begin(), session.cleanup.end(), "hm_ns_put__"),
+						  session.cleanup.end());
+	int result = 1;
+	session.worker.Run([&]() { result = engPutVariable(session.ep, "hm_ns_put__", A); });
+	if (result != 0)
+	{
+		return result;
+	}
+	std::string cmd = WithCleanup(session, (HMatlabNamespaceVar(id) + "." + name + "=hm_ns_put__;").c_str());
+	HMatlabClearLater(session, "hm_ns_put__");
+	return HMatlabEngEval(session, cmd);
+}
+
+mxArray *HMatlabGetVariable(HMatlabSession &session, const char *name)
+{
+	if (HMatlabFlush(session) != 0)
+	{
+		return NULL;
+	}
+	const std::string &id = HMatlabThreadNamespace();
+	mxArray *A = NULL;
+	if (!IsInternal(name))
+	{
+		HMatlabNoteRead(session, name);
+	}
+	if (id.empty() || IsInternal(name))
+	{
+		session.worker.Run([&]() { A = engGetVariable(session.ep, name); });
+		return A;
+	}
+	// 字段不存在时赋值出错，hm_ns_get__ 不存在，和取不存在的变量一样返回 NULL
+	std::string cmd = "clear hm_ns_get__;hm_ns_get__=" + HMatlabNamespaceVar(id) + "." + name + ";";
+	session.cleanup.erase(std::remove(session.cleanup.begin(), session.cleanup.end(), "hm_ns_get__"),
+						  session.cleanup.end());
+	if (HMatlabEngEval(session, WithCleanup(session, cmd.c_str())) != 0)
+	{
+		return NULL;
+	}
+	session.worker.Run([&]() { A = engGetVariable(session.ep, "hm_ns_get__"); });
+	HMatlabClearLater(session, "hm_ns_get__");
+	return A;
+}
+
+// 每条语句各自包在 try/catch 里，和逐条 engEvalString 一样：前面出错不影响后面。
+// 出错语句的序号和错误信息记在 hm_batch_err__ 里，flush 后一次取回。没有出错时
+// 收尾语句把 hm_batch_err__ 清掉，出错时取回后登记清理；hm_e__ 总是清掉
+int HMatlabFlush(HMatlabSession &session)
+{
+	if (session.pending.empty())
+	{
+		return 0;
+	}
+	std::vector<std::string> pending;
+	std::vector<size_t> labels;
+	pending.swap(session.pending);
+	labels.swap(session.pending_label);
+	if (session.ep == NULL)
+	{
+		return 1;
+	}
+
+	// 上一批登记的 hm_batch_err__ 不能在这一批的收尾里清掉
+	session.cleanup.erase(std::remove(session.cleanup.begin(), session.cleanup.end(), "hm_batch_err__"),
+						  session.cleanup.end());
+	std::string script = "hm_batch_err__={};\n";
+	char line[96];
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		script += "try\n";
+		script += pending[i];
+		snprintf(line, sizeof(line),
+				 "\ncatch hm_e__\nhm_batch_err__(end+1,:)={%u,hm_e__.message};\nend\n",
+				 (unsigned)labels[i]);
+		script += line;
+	}
+	script += WithCleanup(session, "clear hm_e__;if isempty(hm_batch_err__),clear hm_batch_err__;end");
+	session.flushes++;
+	session.batched += pending.size();
+	int ret = HMatlabEngEval(session, script);
+	if (ret != 0)
+	{
+		return ret;
+	}
+
+	mxArray *E = NULL;
+	session.worker.Run([&]() { E = engGetVariable(session.ep, "hm_batch_err__"); });
+	if (E != NULL)
+	{
+		HMatlabClearLater(session, "hm_batch_err__");
+	}
+	if (E != NULL && mxIsCell(E) && mxGetN(E) == 2)
+	{
+		size_t rows = mxGetM(E);
+		for (size_t r = 0; r < rows && session.error_index.size() < kHMatlabMaxBatchErrors; r++)
+		{
+			// 元胞按列存放：第 1 列是序号，第 2 列是信息
+			mxArray *idx = mxGetCell(E, r);
+			mxArray *msg = mxGetCell(E, rows + r);
+			session.error_index.push_back(idx != NULL ? (size_t)mxGetScalar(idx) : 0);
+			char *text = msg != NULL ? mxArrayToString(msg) : NULL;
+			session.error_message.push_back(text != NULL ? text : "");
+			mxFree(text);
+		}
+	}
+	if (E != NULL)
+	{
+		mxDestroyArray(E);
+	}
+	return 0;
+}
@@ -0,0 +1,447 @@
+#include "Halcon_MatlabWorker.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+typedef std::chrono::steady_clock HMatlabClock;
+
+struct HMatlabWorker::Job
+{
+	enum Kind
+	{
+		kRun,
+		kPost,
+		kGrant,
+		kRelease
+	};
+
+	Job() : kind(kRun), priority(kHMatlabPriorityNormal), fn(NULL), next(NULL), done(false) {}
+
+	Kind kind;
+	HMatlabPriority priority;
+	const std::function<void()> *fn;
+	std::function<void()> posted; // kPost 的任务自己持有 fn，执行完由工作线程释放
+	std::thread::id owner;
+	HMatlabClock::time_point submitted;
+	std::atomic<Job *> next;
+	std::exception_ptr error;
+	// 提交方在这里等待完成；Job 放在提交方的栈上，完成前不会释放
+	bool done;
+	std::mutex mutex;
+	std::condition_variable cv;
+};
+
+struct HMatlabWorker::State
+{
+	State()
+		: head(&stub), tail(&stub), pending(0), sleeping(false), stop(false), depth(0),
+		  jobs(0), queue_wait_ns(0), queue_wait_max_ns(0), depth_max(0), scopes(0),
+		  scopes_contended(0), scope_wait_ns(0), scope_wait_max_ns(0)
+	{
+		for (int p = 0; p < kHMatlabPriorityCount; p++)
+		{
+			class_scopes[p] = 0;
+			class_wait_ns[p] = 0;
+			class_wait_max_ns[p] = 0;
+		}
+	}
+
+	// Vyukov 的侵入式 MPSC 队列：生产者只做一次 exchange，消费者 (工作线程) 独占 tail
+	std::atomic<Job *> head;
+	Job *tail;
+	Job stub;
+	std::atomic<size_t> pending; // 已入队 (或正在入队) 未取出的任务数
+
+	// 只在队列为空时用来睡眠和唤醒，入队本身不加锁
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::atomic<bool> sleeping;
+	std::atomic<bool> stop;
+
+	std::once_flag started;
+	std::atomic<std::thread::id> worker;
+	std::atomic<std::thread::id> owner; // 当前独占工作线程的调用线程
+	int depth;							// owner 的嵌套层数，只由 owner 自己读写
+
+	std::atomic<uint64_t> jobs;
+	std::atomic<uint64_t> queue_wait_ns;
+	std::atomic<uint64_t> queue_wait_max_ns;
+	std::atomic<uint64_t> depth_max;
+	std::atomic<uint64_t> scopes;
+	std::atomic<uint64_t> scopes_contended;
+	std::atomic<uint64_t> scope_wait_ns;
+	std::atomic<uint64_t> scope_wait_max_ns;
+	std::atomic<uint64_t> class_scopes[kHMatlabPriorityCount];
+	std::atomic<uint64_t> class_wait_ns[kHMatlabPriorityCount];
+	std::atomic<uint64_t> class_wait_max_ns[kHMatlabPriorityCount];
+
+	void Push(Job *job)
+	{
+		job->next.store(NULL, std::memory_order_relaxed);
+		Job *prev = head.exchange(job, std::memory_order_acq_rel);
+		prev->next.store(job, std::memory_order_release);
+	}
+
+	// 只由工作线程调用。生产者刚 exchange 还没接上 next 时返回 NULL，稍后再取
+	Job *Pop()
+	{
+		Job *t = tail;
+		Job *next = t->next.load(std::memory_order_acquire);
+		if (t == &stub)
+		{
+			if (next == NULL)
+			{
+				return NULL;
+			}
+			tail = next;
+			t = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next != NULL)
+		{
+			tail = next;
+			return t;
+		}
+		if (t != head.load(std::memory_order_acquire))
+		{
+			return NULL;
+		}
+		Push(&stub);
+		next = t->next.load(std::memory_order_acquire);
+		if (next != NULL)
+		{
+			tail = next;
+			return t;
+		}
+		return NULL;
+	}
+};
+
+static thread_local HMatlabPriority tls_priority = kHMatlabPriorityNormal;
+
+HMatlabPriority HMatlabThreadPriority()
+{
+	return tls_priority;
+}
+
+void HMatlabSetThreadPriority(HMatlabPriority priority)
+{
+	tls_priority = priority;
+}
+
+static const char *const kPriorityNames[kHMatlabPriorityCount] = {"high", "normal", "background"};
+
+bool HMatlabParsePriority(const std::string &name, HMatlabPriority *priority)
+{
+	for (int p = 0; p < kHMatlabPriorityCount; p++)
+	{
+		if (name == kPriorityNames[p])
+		{
+			*priority = (HMatlabPriority)p;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *HMatlabPriorityName(HMatlabPriority priority)
+{
+	return kPriorityNames[priority];
+}
+
+static void UpdateMax(std::atomic<uint64_t> &max, uint64_t value)
+{
+	uint64_t old = max.load(std::memory_order_relaxed);
+	while (value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+static uint64_t ElapsedNs(HMatlabClock::time_point since)
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(HMatlabClock::now() - since).count();
+}
+
+HMatlabWorker::HMatlabWorker() : state_(new State())
+{
+}
+
+HMatlabWorker::~HMatlabWorker()
+{
+	// 进程退出时 (DLL 卸载) 不能 join：其他线程此时可能已被系统终止，join 也可能卡在
+	// 加载器锁上。通知退出后 detach，线程自己持有 State，不会访问已析构的对象
+	state_->stop.store(true);
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		state_->cv.notify_one();
+	}
+	if (thread_.joinable())
+	{
+		thread_.detach();
+	}
+}
+
+void HMatlabWorker::Start()
+{
+	std::call_once(state_->started, [this]() {
+		thread_ = std::thread(&HMatlabWorker::Loop, state_);
+	});
+}
+
+void HMatlabWorker::Enqueue(Job *job)
+{
+	Start();
+	State &s = *state_;
+	job->owner = std::this_thread::get_id();
+	job->priority = tls_priority;
+	job->submitted = HMatlabClock::now();
+	// 先计数再入队：worker 取出任务后的 fetch_sub 总在这之后，size_t 计数不会先减到负数绕回
+	UpdateMax(s.depth_max, (uint64_t)s.pending.fetch_add(1) + 1);
+	s.Push(job);
+	if (s.sleeping.load())
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.cv.notify_one();
+	}
+}
+
+void HMatlabWorker::Submit(Job *job)
+{
+	Enqueue(job);
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->cv.wait(lock, [job]() { return job->done; });
+}
+
+void HMatlabWorker::Loop(std::shared_ptr<State> state)
+{
+	State &s = *state;
+	s.worker.store(std::this_thread::get_id());
+	// 队列里取出的任务按优先级分开暂存，同一优先级内保持到达顺序
+	std::deque<Job *> deferred[kHMatlabPriorityCount];
+	std::thread::id none;
+	while (true)
+	{
+		// 先把已经到达的任务都取出来，后到的高优先级任务才能排到前面
+		for (Job *queued = s.Pop(); queued != NULL; queued = s.Pop())
+		{
+			s.pending.fetch_sub(1);
+			deferred[queued->priority].push_back(queued);
+		}
+		// 有线程独占时只执行它的任务，否则取优先级最高的一个
+		std::thread::id owner = s.owner.load();
+		Job *job = NULL;
+		for (int p = 0; p < kHMatlabPriorityCount && job == NULL; p++)
+		{
+			for (std::deque<Job *>::iterator it = deferred[p].begin(); it != deferred[p].end(); ++it)
+			{
+				if (owner == none || (*it)->owner == owner)
+				{
+					job = *it;
+					deferred[p].erase(it);
+					break;
+				}
+			}
+		}
+		if (job == NULL)
+		{
+			if (s.pending.load() > 0)
+			{
+				std::this_thread::yield(); // 生产者已计数，还没入队或还没接上 next
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(s.mutex);
+			s.sleeping.store(true);
+			s.cv.wait(lock, [&s]() { return s.pending.load() > 0 || s.stop.load(); });
+			s.sleeping.store(false);
+			if (s.stop.load() && s.pending.load() == 0)
+			{
+				return;
+			}
+			continue;
+		}
+
+		if (job->kind == Job::kGrant)
+		{
+			s.owner.store(job->owner);
+		}
+		else if (job->kind == Job::kRelease)
+		{
+			s.owner.store(none);
+		}
+		else
+		{
+			uint64_t wait = ElapsedNs(job->submitted);
+			s.jobs.fetch_add(1, std::memory_order_relaxed);
+			s.queue_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+			UpdateMax(s.queue_wait_max_ns, wait);
+			try
+			{
+				(*job->fn)();
+			}
+			catch (...)
+			{
+				job->error = std::current_exception();
+			}
+		}
+		if (job->kind == Job::kPost)
+		{
+			delete job; // 没有人等待，异常也无处报告
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->done = true;
+			job->cv.notify_one();
+		}
+	}
+}
+
+void HMatlabWorker::Run(const std::function<void()> &fn)
+{
+	if (state_->worker.load() == std::this_thread::get_id())
+	{
+		fn();
+		return;
+	}
+	Job job;
+	job.fn = &fn;
+	Submit(&job);
+	if (job.error)
+	{
+		std::rethrow_exception(job.error);
+	}
+}
+
+void HMatlabWorker::Post(const std::function<void()> &fn)
+{
+	Job *job = new Job();
+	job->kind = Job::kPost;
+	job->posted = fn;
+	job->fn = &job->posted;
+	Enqueue(job);
+}
+
+void HMatlabWorker::Acquire()
+{
+	State &s = *state_;
+	// 工作线程上执行的是 Post 提交的任务，执行期间不会有别的任务，本来就是独占的
+	if (s.worker.load() == std::this_thread::get_id())
+	{
+		return;
+	}
+	if (s.owner.load() == std::this_thread::get_id())
+	{
+		s.depth++;
+		return;
+	}
+	// 队列里还有任务或者别的线程正独占着，就算一次竞争
+	bool contended = s.pending.load() > 0 || s.owner.load() != std::thread::id();
+	HMatlabClock::time_point start = HMatlabClock::now();
+	Job job;
+	job.kind = Job::kGrant;
+	Submit(&job);
+	s.depth = 1;
+	uint64_t wait = ElapsedNs(start);
+	s.scopes.fetch_add(1, std::memory_order_relaxed);
+	s.scope_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+	UpdateMax(s.scope_wait_max_ns, wait);
+	s.class_scopes[job.priority].fetch_add(1, std::memory_order_relaxed);
+	s.class_wait_ns[job.priority].fetch_add(wait, std::memory_order_relaxed);
+	UpdateMax(s.class_wait_max_ns[job.priority], wait);
+	if (contended)
+	{
+		s.scopes_contended.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void HMatlabWorker::Release()
+{
+	State &s = *state_;
+	if (s.worker.load() == std::this_thread::get_id())
+	{
+		return;
+	}
+	if (--s.depth > 0)
+	{
+		return;
+	}
+	Job job;
+	job.kind = Job::kRelease;
+	Submit(&job);
+}
+
+uint64_t HMatlabWorker::Jobs() const
+{
+	return state_->jobs.load();
+}
+
+uint64_t HMatlabWorker::QueueWaitUs() const
+{
+	return state_->queue_wait_ns.load() / 1000;
+}
+
+uint64_t HMatlabWorker::QueueWaitMaxUs() const
+{
+	return state_->queue_wait_max_ns.load() / 1000;
+}
+
+uint64_t HMatlabWorker::Scopes() const
+{
+	return state_->scopes.load();
+}
+
+uint64_t HMatlabWorker::ScopesContended() const
+{
+	return state_->scopes_contended.load();
+}
+
+uint64_t HMatlabWorker::ScopeWaitUs() const
+{
+	return state_->scope_wait_ns.load() / 1000;
+}
+
+uint64_t HMatlabWorker::ScopeWaitMaxUs() const
+{
+	return state_->scope_wait_max_ns.load() / 1000;
+}
+
+uint64_t HMatlabWorker::Scopes(HMatlabPriority priority) const
+{
+	return state_->class_scopes[priority].load();
+}
+
+uint64_t HMatlabWorker::ScopeWaitUs(HMatlabPriority priority) const
+{
+	return state_->class_wait_ns[priority].load() / 1000;
+}
+
+uint64_t HMatlabWorker::ScopeWaitMaxUs(HMatlabPriority priority) const
+{
+	return state_->class_wait_max_ns[priority].load() / 1000;
+}
+
+uint64_t HMatlabWorker::QueueDepthMax() const
+{
+	return state_->depth_max.load();
+}
+
+void HMatlabWorker::ResetStats()
+{
+	State &s = *state_;
+	s.jobs.store(0);
+	s.queue_wait_ns.store(0);
+	s.queue_wait_max_ns.store(0);
+	s.depth_max.store(0);
+	s.scopes.store(0);
+	s.scopes_contended.store(0);
+	s.scope_wait_ns.store(0);
+	s.scope_wait_max_ns.store(0);
+	for (int p = 0; p < kHMatlabPriorityCount; p++)
+	{
+		s.class_scopes[p].store(0);
+		s.class_wait_ns[p].store(0);
+		s.class_wait_max_ns[p].store(0);
+	}
+}
@@ -0,0 +1,281 @@
+#include "Halcon_MatlabWorkspace.h"
+#include "Halcon_MatlabCpu.h"
+#include "Halcon_MatlabNamespace.h"
+#include <cctype>
+#include <cstring>
+#include <map>
+
+static bool IsTemp(const std::string &name)
+{
+	return name.size() > 5 && name.compare(0, 3, "hm_") == 0 && name.compare(name.size() - 2, 2, "__") == 0;
+}
+
+void HMatlabNoteWrite(HMatlabSession &session, const std::string &name, uint64_t bytes)
+{
+	HMatlabTrackedVar &var = session.tracked[std::make_pair(HMatlabThreadNamespace(), name)];
+	var.bytes = bytes;
+	var.written = session.calls + 1;
+}
+
+void HMatlabNoteRead(HMatlabSession &session, const std::string &name)
+{
+	// 只需要记住读过的临时变量，其他变量读出不改变什么
+	std::pair<std::string, std::string> key(HMatlabThreadNamespace(), name);
+	if (session.transient.count(name) != 0 || session.tracked.count(key) != 0)
+	{
+		session.tracked[key].read = session.calls + 1;
+	}
+}
+
+void HMatlabNoteConsume(HMatlabSession &session)
+{
+	session.consumed = session.calls + 1;
+}
+
+uint64_t HMatlabMxBytes(const mxArray *A)
+{
+	if (A == NULL || mxIsStruct(A) || mxIsCell(A))
+	{
+		return 0;
+	}
+	uint64_t bytes = (uint64_t)mxGetNumberOfElements(A) * mxGetElementSize(A);
+	return mxIsComplex(A) ? bytes * 2 : bytes;
+}
+
+bool HMatlabIsVarName(const std::string &name)
+{
+	if (name.empty() || !isalpha((unsigned char)name[0]))
+	{
+		return false;
+	}
+	for (size_t i = 1; i < name.size(); i++)
+	{
+		if (!isalnum((unsigned char)name[i]) && name[i] != '_')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool HMatlabParseNameList(const std::string &text, std::set<std::string> *names)
+{
+	std::set<std::string> parsed;
+	std::string name;
+	for (size_t i = 0; i <= text.size(); i++)
+	{
+		char c = i < text.size() ? text[i] : ',';
+		if (c == ',' || isspace((unsigned char)c))
+		{
+			if (!name.empty())
+			{
+				parsed.insert(name);
+			}
+			name.clear();
+			continue;
+		}
+		if (!(isalnum((unsigned char)c) || c == '_') || (name.empty() && !isalpha((unsigned char)c)))
+		{
+			return false;
+		}
+		name += c;
+	}
+	names->swap(parsed);
+	return true;
+}
+
+std::string HMatlabFormatNameList(const std::set<std::string> &names)
+{
+	std::string text;
+	for (std::set<std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+	{
+		text += (text.empty() ? "" : ",") + *it;
+	}
+	return text;
+}
+
+// 按命名空间分组 clear，并从记录里删掉。all 为假时只清用过的
+static void ClearTransient(HMatlabSession &session, bool all)
+{
+	uint64_t call = session.calls + 1;
+	std::map<std::string, std::string> commands;
+	std::map<std::pair<std::string, std::string>, HMatlabTrackedVar>::iterator it = session.tracked.begin();
+	while (it != session.tracked.end())
+	{
+		const HMatlabTrackedVar &var = it->second;
+		bool used = var.read == call || (session.consumed == call && var.written != 0 && var.written < call);
+		if (session.transient.count(it->first.second) == 0 || !(all || used))
+		{
+			++it;
+			continue;
+		}
+		std::string &cmd = commands[it->first.first];
+		cmd += (cmd.empty() ? "clear " : " ") + it->first.second;
+		session.auto_cleared++;
+		it = session.tracked.erase(it);
+	}
+	for (std::map<std::string, std::string>::iterator c = commands.begin(); c != commands.end(); ++c)
+	{
+		HMatlabNamespaceGuard ns(c->first);
+		HMatlabEval(session, (c->second + ";").c_str());
+	}
+}
+
+bool HMatlabWorkspaceCleanup(HMatlabSession &session)
+{
+	if (session.ep == NULL)
+	{
+		return false;
+	}
+	ClearTransient(session, true);
+	// 登记过的临时变量随这条语句清掉；出错中断时没登记上的也按名字规则清掉，命名空间除外
+	HMatlabNamespaceGuard base("");
+	return HMatlabEvalNow(session, "clear('-regexp','^hm_(?!ns_)\\w*__$');close all force;") == 0;
+}
+
+// 在基础工作区求一个字符串表达式的值
+static bool EvalToString(HMatlabSession &session, const char *expr, std::string *value)
+{
+	HMatlabNamespaceGuard base("");
+	std::string cmd = std::string("hm_str__=") + expr + ";";
+	mxArray *A = HMatlabEvalNow(session, cmd.c_str()) == 0 ? HMatlabGetVariable(session, "hm_str__") : NULL;
+	HMatlabClearLater(session, "hm_str__");
+	char *text = A != NULL ? mxArrayToString(A) : NULL;
+	if (A != NULL)
+	{
+		mxDestroyArray(A);
+	}
+	if (text == NULL)
+	{
+		return false;
+	}
+	*value = text;
+	mxFree(text);
+	return true;
+}
+
+bool HMatlabRecycleEngine(HMatlabSession &session)
+{
+	// 搜索路径和当前目录不在工作区里，重开的引擎却会回到启动时的默认值，之前 addpath 的函数
+	// 就找不到了。关闭前记下来，重开后恢复
+	std::string path, dir;
+	bool saved = EvalToString(session, "path", &path) && EvalToString(session, "pwd", &dir);
+	HMatlabCloseEngine(session);
+	if (!HMatlabOpenEngine(session))
+	{
+		return false;
+	}
+	if (!saved)
+	{
+		return false;
+	}
+	HMatlabNamespaceGuard base("");
+	mxArray *P = mxCreateString(path.c_str());
+	mxArray *D = mxCreateString(dir.c_str());
+	// 目录可能已经不存在，path / cd 在 MATLAB 里出错不会反映在 engEvalString 的返回值上
+	bool restored = P != NULL && D != NULL && HMatlabPutVariable(session, "hm_path__", P) == 0 &&
+					HMatlabPutVariable(session, "hm_pwd__", D) == 0 &&
+					HMatlabEvalChecked(session, "path(hm_path__);cd(hm_pwd__);");
+	if (P != NULL)
+	{
+		mxDestroyArray(P);
+	}
+	if (D != NULL)
+	{
+		mxDestroyArray(D);
+	}
+	HMatlabClearLater(session, "hm_path__");
+	HMatlabClearLater(session, "hm_pwd__");
+	return restored;
+}
+
+static void EndCall(HMatlabSession &session)
+{
+	if (session.ep != NULL && session.auto_clear)
+	{
+		// 登记的内部临时变量随这里的 clear 语句一起清掉；没有 clear 语句时留给下一条语句，
+		// 不为它单独跑一次引擎
+		ClearTransient(session, false);
+	}
+	session.calls++;
+	if (session.ep == NULL || session.check_interval == 0 || session.calls % session.check_interval != 0 ||
+		(session.soft_limit == 0 && session.hard_limit == 0))
+	{
+		return;
+	}
+	uint64_t resident = 0, peak = 0;
+	HMatlabProcessMemory(HMatlabEnginePid(session), &resident, &peak);
+	session.last_resident = resident;
+	if (session.hard_limit != 0 && resident > session.hard_limit)
+	{
+		// 算子本身已经完成，没法再返回错误；重开或恢复路径失败记在 recycle_failures 里
+		session.recycles++;
+		if (!HMatlabRecycleEngine(session))
+		{
+			session.recycle_failures++;
+		}
+	}
+	else if (session.soft_limit != 0 && resident > session.soft_limit)
+	{
+		session.soft_cleanups++;
+		HMatlabWorkspaceCleanup(session);
+	}
+}
+
+HMatlabCallScope::~HMatlabCallScope()
+{
+	if (--session_.call_depth != 0)
+	{
+		return;
+	}
+	// 清理失败不影响算子本身的结果
+	try
+	{
+		EndCall(session_);
+	}
+	catch (...)
+	{
+	}
+}
+
+bool HMatlabWorkspaceInfo(HMatlabSession &session, std::vector<std::string> *names,
+						  std::vector<std::string> *classes, std::vector<uint64_t> *bytes)
+{
+	names->clear();
+	classes->clear();
+	bytes->clear();
+	// 在命名空间里执行时 whos 列出的是命名空间的变量
+	if (session.ep == NULL || HMatlabEvalNow(session, "hm_whos__=whos;") != 0)
+	{
+		return false;
+	}
+	mxArray *S = HMatlabGetVariable(session, "hm_whos__");
+	HMatlabClearLater(session, "hm_whos__");
+	if (S == NULL || !mxIsStruct(S))
+	{
+		if (S != NULL)
+		{
+			mxDestroyArray(S);
+		}
+		return false;
+	}
+	bool in_namespace = !HMatlabThreadNamespace().empty();
+	for (size_t i = 0; i < mxGetNumberOfElements(S); i++)
+	{
+		char *name = mxArrayToString(mxGetField(S, i, "name"));
+		char *cls = mxArrayToString(mxGetField(S, i, "class"));
+		const mxArray *size = mxGetField(S, i, "bytes");
+		// 基本工作区里的命名空间结构体照常列出，它们占着命名空间里的全部数据
+		std::string text = name != NULL ? name : "";
+		if (!text.empty() && (!IsTemp(text) || (!in_namespace && text.compare(0, 6, "hm_ns_") == 0)))
+		{
+			names->push_back(text);
+			classes->push_back(cls != NULL ? cls : "");
+			bytes->push_back(size != NULL && mxIsNumeric(size) ? (uint64_t)mxGetScalar(size) : 0);
+		}
+		mxFree(name);
+		mxFree(cls);
+	}
+	mxDestroyArray(S);
+	return true;
+}
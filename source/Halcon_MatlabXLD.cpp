@@ -0,0 +1,253 @@
+// XLD 轮廓/多边形和 MATLAB 之间的传输。整个 XLD 元组压成一个缓冲区：
+// 所有点的行、列首尾相接，再加一个偏移数组 offsets (k+1 个，从 0 开始，
+// 第 i 个轮廓是 offsets(i)+1 : offsets(i+1))，一次 engPutVariable / engGetVariable 传完，
+// 在另一端再拆成元胞或结构体数组。
+#include "Halcon_Matlab.h"
+#include "Halcon_MatlabParam.h"
+#include "Halcon_MatlabSession.h"
+#include "Halcon_MatlabWorkspace.h"
+#include <string>
+#include <vector>
+
+#ifndef __APPLE__
+#include "HalconCpp.h"
+#else
+#ifndef HC_LARGE_IMAGES
+#include <HALCONCpp/HalconCpp.h>
+#else
+#include <HALCONCppxl/HalconCpp.h>
+#endif
+#endif
+using namespace HalconCpp;
+
+// 打包后的 MATLAB 结构体 {rows, cols, offsets}，三个字段都是 double 列向量
+static const char *kXLDFields[3] = {"rows", "cols", "offsets"};
+
+Herror HMatlab_engPutXLD(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	Hcpar *GenParamName, *GenParamValue;
+	INT4_8 num_gen_name, num_gen_value;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HGetPPar(proc_handle, 2, &GenParamName, &num_gen_name);
+	HGetPPar(proc_handle, 3, &GenParamValue, &num_gen_value);
+	if (num_gen_name != num_gen_value)
+	{
+		return H_ERR_WIPN3;
+	}
+	// 'cell'：1 x k 元胞，每个元素 n x 2 [row col]
+	// 'struct'：1 x k 结构体数组，字段 row / col
+	// 'packed'：不拆开，直接给出 {rows, cols, offsets}
+	std::string format = "cell";
+	for (INT4_8 i = 0; i < num_gen_name; i++)
+	{
+		if (GenParamName[i].type != STRING_PAR)
+		{
+			return H_ERR_WIPT2;
+		}
+		if (strcmp(GenParamName[i].par.s, "format") != 0)
+		{
+			return H_ERR_WIPV2;
+		}
+		format = HMatlabParString(GenParamValue[i]);
+		if (format != "cell" && format != "struct" && format != "packed")
+		{
+			return H_ERR_WIPV3;
+		}
+	}
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	INT4_8 num_obj;
+	HCkP(HGetObjNum(proc_handle, 1, &num_obj));
+	std::vector<double> rows, cols, offsets(1, 0.0);
+	try
+	{
+		for (INT4_8 k = 0; k < num_obj; k++)
+		{
+			Hkey key;
+			HCkP(HGetObj(proc_handle, 1, k + 1, &key));
+			HObject xld(key);
+			HTuple hv_Class, hv_Row, hv_Col, hv_Length, hv_Phi;
+			GetObjClass(xld, &hv_Class);
+			if (strcmp(hv_Class[0].S(), "xld_poly") == 0)
+			{
+				GetPolygonXld(xld, &hv_Row, &hv_Col, &hv_Length, &hv_Phi);
+			}
+			else
+			{
+				GetContourXld(xld, &hv_Row, &hv_Col);
+			}
+			// 坐标总是实数，直接读元组自己的数组，不用 ToDArr 另外分配一份
+			if (hv_Row.Length() > 0)
+			{
+				const double *r = hv_Row.DArr();
+				const double *c = hv_Col.DArr();
+				rows.insert(rows.end(), r, r + hv_Row.Length());
+				cols.insert(cols.end(), c, c + hv_Col.Length());
+			}
+			offsets.push_back((double)rows.size());
+		}
+	}
+	catch (HException &e)
+	{
+		return (Herror)e.ErrorCode();
+	}
+
+	mxArray *fields[3] = {
+		session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, rows.size(), 1),
+		session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, cols.size(), 1),
+		session.pool.Acquire(mxDOUBLE_CLASS, mxREAL, offsets.size(), 1)};
+	mxArray *S = mxCreateStructMatrix(1, 1, 3, kXLDFields);
+	const std::vector<double> *data[3] = {&rows, &cols, &offsets};
+	Herror err = H_MSG_TRUE;
+	for (int i = 0; i < 3; i++)
+	{
+		if (fields[i] == NULL || S == NULL)
+		{
+			err = H_ERR_MEM;
+			continue;
+		}
+		memcpy(mxGetPr(fields[i]), data[i]->data(), data[i]->size() * sizeof(double));
+		mxSetFieldByNumber(S, 0, i, fields[i]);
+	}
+
+	if (err == H_MSG_TRUE)
+	{
+		const char *target = format == "packed" ? NAME.par.s : "hm_xld__";
+		if (HMatlabPutVariable(session, target, S) != 0)
+		{
+			err = H_ERR_MATLAB_ENGINE;
+		}
+		else if (format != "packed")
+		{
+			// mat2cell 按偏移一次切开，不在 MATLAB 里逐个循环
+			std::string name = NAME.par.s;
+			std::string cmd = "hm_n__=diff(hm_xld__.offsets);";
+			if (format == "cell")
+			{
+				cmd += name + "=reshape(mat2cell([hm_xld__.rows,hm_xld__.cols],hm_n__,2),1,[]);";
+			}
+			else
+			{
+				cmd += name + "=reshape(struct('row',mat2cell(hm_xld__.rows,hm_n__,1),"
+							  "'col',mat2cell(hm_xld__.cols,hm_n__,1)),1,[]);";
+			}
+			if (HMatlabEval(session, cmd.c_str()) != 0)
+			{
+				err = H_ERR_MATLAB_ENGINE;
+			}
+			HMatlabClearLater(session, "hm_xld__");
+			HMatlabClearLater(session, "hm_n__");
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (S != NULL)
+		{
+			mxSetFieldByNumber(S, 0, i, NULL);
+		}
+		session.pool.Release(fields[i]);
+	}
+	if (S != NULL)
+	{
+		mxDestroyArray(S);
+	}
+	return err;
+}
+
+// 总是生成 xld_cont：打包格式里不记录类别，Matlab_engPutXLD 上传的 xld_poly 取回来是
+// 同样顶点的轮廓，需要多边形时再用 gen_polygons_xld 转换
+Herror HMatlab_engGetXLD(Hproc_handle proc_handle)
+{
+	Hcpar NAME;
+	HAllocStringMem(proc_handle, 1024);
+	HGetSPar(proc_handle, 1, STRING_PAR, &NAME, 1);
+	HMatlabSession &session = HMatlabGetSession();
+	HMatlabCallScope scope(session);
+	if (session.ep == NULL)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	// 在 MATLAB 里先压成 {rows, cols, offsets} 再一次取回。接受三种写法：
+	// n x 2 矩阵的元胞、带 row/col 字段的结构体数组、已经打包好的结构体
+	std::string name = NAME.par.s;
+	std::string cmd =
+		"hm_xld__=" + name + ";"
+		"if iscell(hm_xld__)"
+		" hm_n__=cellfun('size',hm_xld__(:),1);"
+		" hm_m__=double(vertcat(zeros(0,2),hm_xld__{:}));"
+		" hm_xld__=struct('rows',hm_m__(:,1),'cols',hm_m__(:,2),'offsets',[0;cumsum(hm_n__)]);"
+		"elseif isstruct(hm_xld__)&&isfield(hm_xld__,'row')"
+		" hm_r__=cellfun(@(v)v(:),{hm_xld__.row},'UniformOutput',false);"
+		" hm_c__=cellfun(@(v)v(:),{hm_xld__.col},'UniformOutput',false);"
+		" hm_n__=cellfun('prodofsize',hm_r__(:));"
+		" hm_xld__=struct('rows',double(vertcat(zeros(0,1),hm_r__{:})),"
+		"'cols',double(vertcat(zeros(0,1),hm_c__{:})),'offsets',[0;cumsum(hm_n__)]);"
+		"end";
+	if (HMatlabEvalNow(session, cmd.c_str()) != 0)
+	{
+		return H_ERR_MATLAB_ENGINE;
+	}
+	mxArray *S = HMatlabGetVariable(session, "hm_xld__");
+	const char *temps[] = {"hm_xld__", "hm_n__", "hm_m__", "hm_r__", "hm_c__"};
+	for (size_t i = 0; i < sizeof(temps) / sizeof(temps[0]); i++)
+	{
+		HMatlabClearLater(session, temps[i]);
+	}
+	const mxArray *fields[3] = {NULL, NULL, NULL};
+	bool ok = S != NULL && mxIsStruct(S) && mxGetNumberOfElements(S) == 1;
+	for (int i = 0; ok && i < 3; i++)
+	{
+		fields[i] = mxGetField(S, 0, kXLDFields[i]);
+		ok = fields[i] != NULL && mxIsDouble(fields[i]) && !mxIsComplex(fields[i]) &&
+			 !mxIsSparse(fields[i]);
+	}
+	ok = ok && mxGetNumberOfElements(fields[0]) == mxGetNumberOfElements(fields[1]) &&
+		 mxGetNumberOfElements(fields[2]) >= 1;
+	if (!ok)
+	{
+		if (S != NULL)
+		{
+			mxDestroyArray(S);
+		}
+		return H_ERR_MATLAB_ENGINE;
+	}
+
+	const double *rows = mxGetPr(fields[0]);
+	const double *cols = mxGetPr(fields[1]);
+	const double *offsets = mxGetPr(fields[2]);
+	size_t total = mxGetNumberOfElements(fields[0]);
+	size_t num = mxGetNumberOfElements(fields[2]) - 1;
+	Herror err = H_MSG_TRUE;
+	try
+	{
+		for (size_t k = 0; err == H_MSG_TRUE && k < num; k++)
+		{
+			size_t begin = (size_t)offsets[k];
+			size_t end = (size_t)offsets[k + 1];
+			if (offsets[k] < 0 || begin > end || end > total)
+			{
+				err = H_ERR_MATLAB_ENGINE;
+				break;
+			}
+			HObject contour;
+			GenContourPolygonXld(&contour, HTuple(rows + begin, (Hlong)(end - begin)),
+								 HTuple(cols + begin, (Hlong)(end - begin)));
+			Hkey key;
+			err = HCopyObj(proc_handle, contour.Key(), 1, &key);
+		}
+	}
+	catch (HException &e)
+	{
+		err = (Herror)e.ErrorCode();
+	}
+	mxDestroyArray(S);
+	return err;
+}